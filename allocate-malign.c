@@ -16,10 +16,11 @@
  * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
-static void *allocPool(int mustSucceed)
+/* allocate ct contiguous pools */
+static void *allocPools(ggc_size_t ct, int mustSucceed)
 {
     void *ret;
-    if ((errno = posix_memalign(&ret, GGGGC_POOL_BYTES, GGGGC_POOL_BYTES))) {
+    if ((errno = posix_memalign(&ret, GGGGC_POOL_BYTES, GGGGC_POOL_BYTES*ct))) {
         if (mustSucceed) {
             perror("posix_memalign");
             abort();
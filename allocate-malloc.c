@@ -16,7 +16,8 @@
  * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
-static void *allocPool(int mustSucceed)
+/* allocate ct contiguous pools */
+static void *allocPools(ggc_size_t ct, int mustSucceed)
 {
     static ggc_mutex_t poolLock = GGC_MUTEX_INITIALIZER;
     static unsigned char *space = NULL, *spaceEnd = NULL;
@@ -24,15 +25,16 @@ static void *allocPool(int mustSucceed)
 
     /* do we already have some available space? */
     ggc_mutex_lock_raw(&poolLock);
-    if (!space || space + GGGGC_POOL_BYTES > spaceEnd) {
-        ggc_size_t i;
+    if (!space || space + GGGGC_POOL_BYTES * ct > spaceEnd) {
+        ggc_size_t i, min = ct + 1;
 
         /* since we can't pre-align, align by getting as much as we can manage */
-        for (i = 16; i >= 2; i /= 2) {
+        for (i = (min > 16) ? min : 16; i >= min; i /= 2) {
             space = malloc(GGGGC_POOL_BYTES * i);
             if (space) break;
         }
         if (!space) {
+            ggc_mutex_unlock(&poolLock);
             if (mustSucceed) {
                 perror("malloc");
                 abort();
@@ -46,7 +48,7 @@ static void *allocPool(int mustSucceed)
     }
 
     ret = (struct GGGGC_Pool *) space;
-    space += GGGGC_POOL_BYTES;
+    space += GGGGC_POOL_BYTES * ct;
     ggc_mutex_unlock(&poolLock);
 
     return ret;
@@ -16,14 +16,15 @@
  * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
-static void *allocPool(int mustSucceed)
+/* allocate ct contiguous pools */
+static void *allocPools(ggc_size_t ct, int mustSucceed)
 {
     unsigned char *space, *aspace;
     struct GGGGC_Pool *ret;
 
     /* allocate enough space that we can align it later */
-    space = mmap(NULL, GGGGC_POOL_BYTES*2, PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, 0);
-    if (space == NULL) {
+    space = mmap(NULL, GGGGC_POOL_BYTES*(ct+1), PROT_READ|PROT_WRITE, MAP_PRIVATE|MAP_ANON, -1, 0);
+    if (space == MAP_FAILED) {
         if (mustSucceed) {
             perror("mmap");
             abort();
@@ -38,7 +39,7 @@ static void *allocPool(int mustSucceed)
     /* free unused space */
     if (aspace > space)
         munmap(space, aspace - space);
-    munmap(aspace + GGGGC_POOL_BYTES, space + GGGGC_POOL_BYTES - aspace);
+    munmap(aspace + GGGGC_POOL_BYTES*ct, space + GGGGC_POOL_BYTES - aspace);
 
     return ret;
 }
@@ -0,0 +1,82 @@
+/*
+ * Allocation functions (one reservation, committed a pool at a time)
+ *
+ * Copyright (c) 2014, 2015 Gregor Richards
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+
+/* the next pool of the reservation that's never been used, and its size */
+static unsigned char *reserveNext;
+static ggc_size_t reserveSize;
+
+/* reserve the whole heap the first time, with no access, aligned to a pool.
+ * If the address space is limited, settle for less */
+static void reserveHeap()
+{
+    unsigned char *space, *aspace;
+    ggc_size_t size = (ggc_size_t) 1 << GGGGC_HEAP_RESERVE;
+
+    while (1) {
+        space = mmap(NULL, size + GGGGC_POOL_BYTES, PROT_NONE,
+                     MAP_PRIVATE|MAP_ANON|MAP_NORESERVE, -1, 0);
+        if (space != MAP_FAILED) break;
+        if (size <= GGGGC_POOL_BYTES) {
+            perror("mmap");
+            abort();
+        }
+        size /= 2;
+    }
+
+    /* align it, and free the slack */
+    aspace = (unsigned char *) GGGGC_POOL_OF(space + GGGGC_POOL_BYTES - 1);
+    if (aspace > space)
+        munmap(space, aspace - space);
+    munmap(aspace + size, space + GGGGC_POOL_BYTES - aspace);
+
+    ggggc_heapBase = (ggc_size_t) aspace;
+    reserveNext = aspace;
+    reserveSize = size;
+}
+
+/* commit the next ct pools of the reservation, in address order */
+static void *allocPools(ggc_size_t ct, int mustSucceed)
+{
+    unsigned char *ret;
+
+    if (!reserveNext) reserveHeap();
+
+    if ((ggc_size_t) (reserveNext - (unsigned char *) ggggc_heapBase) + GGGGC_POOL_BYTES*ct > reserveSize) {
+        if (mustSucceed) {
+            fprintf(stderr, "GGGGC: heap reservation exhausted\n");
+            abort();
+        }
+        return NULL;
+    }
+
+    ret = reserveNext;
+    if (mprotect(ret, GGGGC_POOL_BYTES*ct, PROT_READ|PROT_WRITE) != 0) {
+        if (mustSucceed) {
+            perror("mprotect");
+            abort();
+        }
+        return NULL;
+    }
+    reserveNext += GGGGC_POOL_BYTES*ct;
+
+    return ret;
+}
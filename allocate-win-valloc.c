@@ -16,14 +16,15 @@
  * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
  */
 
-static void *allocPool(int mustSucceed)
+/* allocate ct contiguous pools */
+static void *allocPools(ggc_size_t ct, int mustSucceed)
 {
     unsigned char *space, *aspace;
     struct GGGGC_Pool *ret;
 
     /* allocate enough space that we can align it later */
     space = (unsigned char *)
-        VirtualAlloc(NULL, GGGGC_POOL_BYTES*2, MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
+        VirtualAlloc(NULL, GGGGC_POOL_BYTES*(ct+1), MEM_COMMIT|MEM_RESERVE, PAGE_READWRITE);
     if (space == NULL) {
         if (mustSucceed) {
             perror("mmap");
@@ -39,7 +40,7 @@ static void *allocPool(int mustSucceed)
     /* free unused space */
     if (aspace > space)
         VirtualFree(space, aspace - space, MEM_RELEASE);
-    VirtualFree(aspace + GGGGC_POOL_BYTES, space + GGGGC_POOL_BYTES - aspace, MEM_RELEASE);
+    VirtualFree(aspace + GGGGC_POOL_BYTES*ct, space + GGGGC_POOL_BYTES - aspace, MEM_RELEASE);
 
     return ret;
 }
@@ -33,6 +33,7 @@
 #endif
 
 #include <errno.h>
+#include <stddef.h>
 #include <stdlib.h>
 #include <stdio.h>
 #include <string.h>
@@ -49,8 +50,42 @@
 extern "C" {
 #endif
 
+/* with GGGGC_HUGE_PAGES, ask for a new pool to be backed by huge pages, and
+ * with GGGGC_POPULATE_POOLS, fault it all in now rather than on first touch */
+static void preparePool(unsigned char *pool, ggc_size_t size)
+{
+#if defined(GGGGC_HUGE_PAGES) && defined(MADV_HUGEPAGE)
+    madvise(pool, size, MADV_HUGEPAGE);
+#endif
+#ifdef GGGGC_POPULATE_POOLS
+    {
+        volatile unsigned char *page;
+#ifdef MADV_POPULATE_WRITE
+        if (madvise(pool, size, MADV_POPULATE_WRITE) == 0) return;
+#endif
+        /* a write to each page, keeping what's there */
+        for (page = pool; page < pool + size; page += 4096) {
+            *page = *page;
+        }
+    }
+#endif
+    (void) pool; (void) size;
+}
+
 /* figure out which allocator to use */
-#if defined(GGGGC_USE_MALLOC)
+#if defined(GGGGC_HEAP_RESERVE)
+#ifndef MAP_ANON
+#error GGGGC_HEAP_RESERVE needs mmap
+#endif
+#define GGGGC_ALLOCATOR_RESERVE 1
+#include "allocate-reserve.c"
+
+#elif defined(GGGGC_HUGE_PAGES) && defined(MAP_ANON)
+/* our own mappings, so that madvise() covers nothing but pools */
+#define GGGGC_ALLOCATOR_MMAP 1
+#include "allocate-mmap.c"
+
+#elif defined(GGGGC_USE_MALLOC)
 #define GGGGC_ALLOCATOR_MALLOC 1
 #include "allocate-malloc.c"
 
@@ -73,78 +108,243 @@ extern "C" {
 
 #endif
 
-/* pools which are freely available */
+/* pools which are freely available, oldest first, and those of them whose
+ * memory has gone back to the OS */
 static struct GGGGC_Pool *freePoolsHead, *freePoolsTail;
+static struct GGGGC_Pool *decommittedPools;
+static ggc_size_t freePoolCt, decommittedPoolCt, reservedPoolCt;
 
-/* allocate and initialize a pool */
-static struct GGGGC_Pool *newPool(int mustSucceed)
+#if defined(GGGGC_ALLOCATOR_VIRTUALALLOC) || defined(MADV_DONTNEED)
+#define GGGGC_CAN_DECOMMIT 1
+
+/* the size of a page, all of a decommitted pool but the first of which is
+ * given back, since it links the free pools */
+static ggc_size_t pageSize()
 {
-    struct GGGGC_Pool *ret;
+#if defined(_SC_PAGESIZE)
+    long ret = sysconf(_SC_PAGESIZE);
+    if (ret > 0) return (ggc_size_t) ret;
+#endif
+    return 4096;
+}
 
-    ret = NULL;
+static void decommitPool(struct GGGGC_Pool *pool)
+{
+    ggc_size_t skip = pageSize();
+#ifdef GGGGC_ALLOCATOR_VIRTUALALLOC
+    VirtualFree((unsigned char *) pool + skip, GGGGC_POOL_BYTES - skip, MEM_DECOMMIT);
+#else
+    madvise((unsigned char *) pool + skip, GGGGC_POOL_BYTES - skip, MADV_DONTNEED);
+#endif
+}
 
-    /* try to reuse a pool */
-    if (freePoolsHead) {
-        if (freePoolsHead) {
-            ret = freePoolsHead;
-            freePoolsHead = freePoolsHead->next;
-            if (!freePoolsHead) freePoolsTail = NULL;
-        }
+static void recommitPool(struct GGGGC_Pool *pool)
+{
+#ifdef GGGGC_ALLOCATOR_VIRTUALALLOC
+    ggc_size_t skip = pageSize();
+    if (!VirtualAlloc((unsigned char *) pool + skip, GGGGC_POOL_BYTES - skip, MEM_COMMIT, PAGE_READWRITE)) {
+        perror("VirtualAlloc");
+        abort();
     }
+#else
+    (void) pool;
+#endif
+}
+#endif
 
-    /* otherwise, allocate one */
-    if (!ret) ret = (struct GGGGC_Pool *) allocPool(mustSucceed);
+/* the runs of pools large objects were freed from, kept whole so that later
+ * large objects can have them back. They're in address order, with
+ * neighbours merged, and each's first pool's end is where the run ends. Their
+ * memory goes back to the OS as they're freed */
+static struct GGGGC_Pool *freeRuns;
+static ggc_size_t freeRunPoolCt;
 
-    if (!ret) return NULL;
+/* pools in a free run */
+#define RUN_POOL_CT(run) (((ggc_size_t *) (run)->end - (ggc_size_t *) (run)) / GGGGC_WORDS_PER_POOL)
 
-    /* set it up */
-    ret->next = NULL;
-    ret->free = ret->start;
-    ret->end = (ggc_size_t *) ((unsigned char *) ret + GGGGC_POOL_BYTES);
+/* the nth pool of a run */
+#define RUN_POOL(run, n) ((struct GGGGC_Pool *) ((unsigned char *) (run) + (n)*GGGGC_POOL_BYTES))
 
-    return ret;
+/* give back a run of ct pools */
+static void freeRun(struct GGGGC_Pool *run, ggc_size_t ct)
+{
+    struct GGGGC_Pool *before, *after;
+#ifdef GGGGC_CAN_DECOMMIT
+    ggc_size_t i;
+
+    /* a pool at a time, so that each keeps its first page for a header */
+    for (i = 0; i < ct; i++) {
+        decommitPool(RUN_POOL(run, i));
+    }
+#endif
+
+    run->end = (ggc_size_t *) run + ct*GGGGC_WORDS_PER_POOL;
+    freeRunPoolCt += ct;
+
+    before = NULL;
+    for (after = freeRuns; after && (ggc_size_t) after < (ggc_size_t) run; after = after->next) {
+        before = after;
+    }
+    run->next = after;
+    if (after && run->end == (ggc_size_t *) after) {
+        run->end = after->end;
+        run->next = after->next;
+    }
+    if (before && before->end == (ggc_size_t *) run) {
+        before->end = run->end;
+        before->next = run->next;
+    }
+    else if (before) {
+        before->next = run;
+    }
+    else {
+        freeRuns = run;
+    }
 }
 
-static struct GGGGC_PoolOld *newPoolOld(int mustSucceed)
+/* ct pools from the front of the first free run that has as many, or NULL */
+static struct GGGGC_Pool *takeRun(ggc_size_t ct)
 {
-    struct GGGGC_PoolOld *ret;
+    struct GGGGC_Pool *before, *run, *rest;
+#ifdef GGGGC_CAN_DECOMMIT
+    ggc_size_t i;
+#endif
 
-    ret = NULL;
+    before = NULL;
+    for (run = freeRuns; run && RUN_POOL_CT(run) < ct; run = run->next) {
+        before = run;
+    }
+    if (!run) return NULL;
+
+    rest = run->next;
+    if (RUN_POOL_CT(run) > ct) {
+        rest = RUN_POOL(run, ct);
+        rest->next = run->next;
+        rest->end = run->end;
+    }
+    if (before) {
+        before->next = rest;
+    }
+    else {
+        freeRuns = rest;
+    }
+    freeRunPoolCt -= ct;
+
+#ifdef GGGGC_CAN_DECOMMIT
+    for (i = 0; i < ct; i++) {
+        recommitPool(RUN_POOL(run, i));
+    }
+#endif
+    preparePool((unsigned char *) run, ct*GGGGC_POOL_BYTES);
+    return run;
+}
+
+/* a free pool to reuse, committed if there is one, or else a new one */
+static struct GGGGC_Pool *reusePool(int mustSucceed)
+{
+    struct GGGGC_Pool *ret;
 
-    /* try to reuse a pool */
     if (freePoolsHead) {
-        if (freePoolsHead) {
-            ret = (struct GGGGC_PoolOld *)freePoolsHead;
-            freePoolsHead = freePoolsHead->next;
-            if (!freePoolsHead) freePoolsTail = NULL;
-        }
+        ret = freePoolsHead;
+        freePoolsHead = freePoolsHead->next;
+        if (!freePoolsHead) freePoolsTail = NULL;
+        freePoolCt--;
+        return ret;
+    }
+
+#ifdef GGGGC_CAN_DECOMMIT
+    if (decommittedPools) {
+        ret = decommittedPools;
+        decommittedPools = decommittedPools->next;
+        decommittedPoolCt--;
+        recommitPool(ret);
+        preparePool((unsigned char *) ret, GGGGC_POOL_BYTES);
+        return ret;
     }
+#endif
+
+    ret = takeRun(1);
+    if (ret) return ret;
+
+    ret = (struct GGGGC_Pool *) allocPools(1, mustSucceed);
+    if (ret) {
+        reservedPoolCt++;
+        preparePool((unsigned char *) ret, GGGGC_POOL_BYTES);
+    }
+    return ret;
+}
 
-    /* otherwise, allocate one */
-    if (!ret) ret = (struct GGGGC_PoolOld *) allocPool(mustSucceed);
+/* give the memory of the free pools beyond GGGGC_FREE_POOLS_COMMITTED, and
+ * of those unused for GGGGC_FREE_POOL_IDLE_MS, back to the OS */
+void ggggc_trimFreePools()
+{
+#ifdef GGGGC_CAN_DECOMMIT
+    struct GGGGC_Pool *pool;
+    ggc_size_t now = ggggc_nsTime();
+
+    while (freePoolsHead &&
+           (freePoolCt > GGGGC_FREE_POOLS_COMMITTED ||
+            now - freePoolsHead->freedAt > (ggc_size_t) GGGGC_FREE_POOL_IDLE_MS * 1000000)) {
+        pool = freePoolsHead;
+        freePoolsHead = pool->next;
+        if (!freePoolsHead) freePoolsTail = NULL;
+        freePoolCt--;
+
+        decommitPool(pool);
+        pool->next = decommittedPools;
+        decommittedPools = pool;
+        decommittedPoolCt++;
+    }
+#endif
+}
+
+/* allocate and initialize a pool */
+static struct GGGGC_Pool *newPool(int mustSucceed)
+{
+    struct GGGGC_Pool *ret;
 
+    ret = reusePool(mustSucceed);
     if (!ret) return NULL;
 
     /* set it up */
     ret->next = NULL;
-    memset(ret->rememberSet, 0, REMEMBERSET_SIZE*sizeof(ggc_size_t));
-    ret->maxRememberSetIndex = 0;
-    ret->minRememberSetIndex = REMEMBERSET_SIZE - 1;
     ret->free = ret->start;
     ret->end = (ggc_size_t *) ((unsigned char *) ret + GGGGC_POOL_BYTES);
 
     return ret;
 }
 
-void ggggc_expandB0()
+/* clear an old pool's remembered slots and marks */
+static void clearPoolOld(struct GGGGC_PoolOld *ret)
 {
-    while (pCtB0 < pCtB1 * B0_B1_RATIO) {
-        b0End->next = newPool(1);
-        b0End = b0End->next;
-        b0End->gen = GEN_OF_B0;
+#ifdef GGGGC_CARD_TABLE
+    memset(ret->cards, 0, GGGGC_CARDS_PER_POOL);
+    memset(ret->crossing, GGGGC_CROSSING_NONE, GGGGC_CARDS_PER_POOL);
+#else
+    memset(ret->rememberSet, 0, REMEMBERSET_SIZE*sizeof(ggc_size_t));
+    memset(ret->rememberSummary, 0, REMEMBERSUMMARY_SIZE*sizeof(ggc_size_t));
+#endif
+    memset(ret->markBitmap, 0, REMEMBERSET_SIZE*sizeof(ggc_size_t));
+#ifdef GGGGC_EVACUATE_OLD
+    ret->survivors = 0;
+    ret->evacuate = 0;
+#endif
+}
 
-        pCtB0++;
-    }
+static struct GGGGC_PoolOld *newPoolOld(int mustSucceed)
+{
+    struct GGGGC_PoolOld *ret;
+
+    ret = (struct GGGGC_PoolOld *) reusePool(mustSucceed);
+    if (!ret) return NULL;
+
+    /* set it up */
+    ret->next = NULL;
+    clearPoolOld(ret);
+    ret->free = ret->start;
+    ret->end = (ggc_size_t *) ((unsigned char *) ret + GGGGC_POOL_BYTES);
+
+    return ret;
 }
 
 void ggggc_expandB1(int poolsNeed)
@@ -153,11 +353,11 @@ void ggggc_expandB1(int poolsNeed)
     for (i = 0; i < poolsNeed; i++) {
         b1ToEnd->next = newPool(1);
         b1ToEnd = b1ToEnd->next;
-        b1ToEnd->gen = GEN_OF_B1TO;
+        GGGGC_SET_GEN(b1ToEnd, GEN_OF_B1TO);
 
         b1FromEnd->next = newPool(1);
         b1FromEnd = b1FromEnd->next;
-        b1FromEnd->gen = GEN_OF_B1FROM;
+        GGGGC_SET_GEN(b1FromEnd, GEN_OF_B1FROM);
 
         pCtB1 += 2;
     }
@@ -169,12 +369,86 @@ void ggggc_expandOld(int poolsNeed)
     for (i = 0; i < poolsNeed; i++) {
         oldEnd->next = newPoolOld(1);
         oldEnd = oldEnd->next;
-        oldEnd->gen = GEN_OF_OLD;
+        GGGGC_SET_GEN(oldEnd, GEN_OF_OLD);
 
         pCtOld++;
     }
 }
 
+/* how many pools of a generation are in use, up to and including cur */
+static ggc_size_t poolsInUse(struct GGGGC_Pool *head, struct GGGGC_Pool *cur)
+{
+    ggc_size_t ct = 1;
+    for (; head != cur; head = head->next) ct++;
+    return ct;
+}
+
+/* cut a generation down to its first keep pools, giving the rest back to be
+ * reused, and return its new last pool */
+static struct GGGGC_Pool *truncatePools(struct GGGGC_Pool *head, ggc_size_t keep)
+{
+    ggc_size_t i;
+    for (i = 1; i < keep; i++) head = head->next;
+    ggggc_freeGeneration(head->next);
+    head->next = NULL;
+    return head;
+}
+
+/* grow or shrink each generation to this many pools, for the sizing
+ * policy. They only shrink by their unused pools at the end */
+void ggggc_resizeB0(ggc_size_t pools)
+{
+    ggc_size_t inUse = poolsInUse(b0Head, b0Cur);
+
+    if (pools < inUse) pools = inUse;
+    while (pCtB0 < pools) {
+        b0End->next = newPool(1);
+        b0End = b0End->next;
+        GGGGC_SET_GEN(b0End, GEN_OF_B0);
+
+        pCtB0++;
+    }
+    if (pCtB0 > pools) {
+        b0End = truncatePools(b0Head, pools);
+        pCtB0 = pools;
+    }
+}
+
+void ggggc_resizeB1(ggc_size_t pools)
+{
+    ggc_size_t pairs, inUse;
+
+    /* a pool in each of tospace and fromspace */
+    pairs = (pools + 1) / 2;
+    inUse = poolsInUse(b1ToHead, b1ToCur);
+    if (pairs < inUse) pairs = inUse;
+    inUse = poolsInUse(b1FromHead, b1FromCur);
+    if (pairs < inUse) pairs = inUse;
+
+    if (pCtB1 < pairs*2) {
+        ggggc_expandB1(pairs - pCtB1/2);
+    }
+    else if (pCtB1 > pairs*2) {
+        b1ToEnd = truncatePools(b1ToHead, pairs);
+        b1FromEnd = truncatePools(b1FromHead, pairs);
+        pCtB1 = pairs*2;
+    }
+}
+
+void ggggc_resizeOld(ggc_size_t pools)
+{
+    ggc_size_t inUse = poolsInUse((struct GGGGC_Pool *)oldHead, (struct GGGGC_Pool *)oldCur);
+
+    if (pools < inUse) pools = inUse;
+    if (pCtOld < pools) {
+        ggggc_expandOld(pools - pCtOld);
+    }
+    else if (pCtOld > pools) {
+        oldEnd = (struct GGGGC_PoolOld *)truncatePools((struct GGGGC_Pool *)oldHead, pools);
+        pCtOld = pools;
+    }
+}
+
 static void initialize()
 {
     GEN_OF_B1TO = 0;
@@ -183,10 +457,10 @@ static void initialize()
     GEN_OF_OLD = 3;
 
     b1ToHead = newPool(1);
-    b1ToHead->gen = GEN_OF_B1TO;
+    GGGGC_SET_GEN(b1ToHead, GEN_OF_B1TO);
     b1ToEnd = b1ToHead;
     b1FromHead = newPool(1);
-    b1FromHead->gen = GEN_OF_B1FROM;
+    GGGGC_SET_GEN(b1FromHead, GEN_OF_B1FROM);
     b1FromEnd = b1FromHead;
     pCtB1 = 2;
     lCtB1 = 0;
@@ -194,14 +468,14 @@ static void initialize()
     b1FromCur = b1FromHead;
 
     b0Head = newPool(1);
-    b0Head->gen = GEN_OF_B0;
+    GGGGC_SET_GEN(b0Head, GEN_OF_B0);
     b0End = b0Head;
     pCtB0 = 1;
-    ggggc_expandB0();
     b0Cur = b0Head;
+    ggggc_resizeB0(pCtB1 * B0_B1_RATIO);
 
     oldHead = newPoolOld(1);
-    oldHead->gen = GEN_OF_OLD;
+    GGGGC_SET_GEN(oldHead, GEN_OF_OLD);
     oldEnd = oldHead;
     pCtOld = 1;
     lCtOld = 0;
@@ -212,6 +486,9 @@ static void initialize()
     mustAllocPool = 0;
     skipFreelist = 0;
     freelisthops = 0;
+
+    ggggc_chooseBitmapScan();
+    ggggc_initSizingPolicy();
 }
 
 /* heuristically expand a generation if it has too many survivors */
@@ -249,54 +526,278 @@ void ggggc_expandGeneration(struct GGGGC_Pool *pool)
 /* free a generation (used when a thread exits) */
 void ggggc_freeGeneration(struct GGGGC_Pool *pool)
 {
+    ggc_size_t now;
+
     if (!pool) return;
     if (freePoolsHead) {
         freePoolsTail->next = pool;
     } else {
         freePoolsHead = pool;
     }
-    while (pool->next) pool = pool->next;
+    now = ggggc_nsTime();
+    while (1) {
+        pool->freedAt = now;
+        freePoolCt++;
+        if (!pool->next) break;
+        pool = pool->next;
+    }
     freePoolsTail = pool;
 }
 
-void *ggggc_malloc(struct GGGGC_Descriptor *descriptor)
+/* give back an old pool that nothing in survived the sweep, after prev */
+void ggggc_releaseOldPool(struct GGGGC_PoolOld *prev, struct GGGGC_PoolOld *pool)
 {
-    ggc_size_t *ret = NULL;
-    
+    if (prev) {
+        prev->next = pool->next;
+    }
+    else {
+        oldHead = pool->next;
+    }
+    pool->next = NULL;
+    ggggc_freeGeneration((struct GGGGC_Pool *) pool);
+    pCtOld--;
+}
+
+/* give back a large object's pools, after prev in the large object space */
+void ggggc_releaseLargePool(struct GGGGC_PoolOld *prev, struct GGGGC_PoolOld *pool)
+{
+    ggc_size_t ct;
+
+    if (prev) {
+        prev->next = pool->next;
+    }
+    else {
+        largeHead = pool->next;
+    }
+
+    /* a lone pool is like any other, but a longer run is kept whole */
+    ct = RUN_POOL_CT(pool);
+    if (ct == 1) {
+        pool->next = NULL;
+        ggggc_freeGeneration((struct GGGGC_Pool *) pool);
+    }
+    else {
+        freeRun((struct GGGGC_Pool *) pool, ct);
+    }
+    pCtLarge -= ct;
+}
+
+void ggggc_getHeapStats(struct GGGGC_HeapStats *stats)
+{
+    ggc_mutex_lock(&ggggc_allocLock);
+    stats->reservedBytes = reservedPoolCt * GGGGC_POOL_BYTES;
+    stats->committedBytes = stats->reservedBytes;
+#ifdef GGGGC_CAN_DECOMMIT
+    stats->committedBytes -= (decommittedPoolCt + freeRunPoolCt) * (GGGGC_POOL_BYTES - pageSize());
+#endif
+    stats->b0Pools = pCtB0;
+    stats->b1Pools = pCtB1;
+    stats->oldPools = pCtOld;
+    stats->largePools = pCtLarge;
+    stats->freePools = freePoolCt + decommittedPoolCt + freeRunPoolCt;
+    ggc_mutex_unlock(&ggggc_allocLock);
+}
+
+/* give back what's left of a thread's TLAB, as a free run so B0 stays
+ * walkable */
+void ggggc_retireTLAB(struct GGGGC_ThreadInfo *ti)
+{
+    struct GGGGC_Freeobj *fo;
+
+    if (ti->tlabFree < ti->tlabEnd) {
+        fo = (struct GGGGC_Freeobj *)ti->tlabFree;
+        fo->selfend = (ggc_size_t *)((ggc_size_t)(ti->tlabEnd - 1) | 2);
+    }
+    ti->tlabFree = ti->tlabEnd = NULL;
+}
+
+/* retire every thread's TLAB, before collecting */
+void ggggc_retireTLABs()
+{
+    struct GGGGC_ThreadInfo *ti;
+
+    for (ti = ggggc_threads; ti; ti = ti->next) {
+        ggggc_retireTLAB(ti);
+    }
+}
+
+#ifndef GGGGC_NO_LARGE_OBJECTS
+/* words before a pool's content */
+#define POOLOLD_HEADER_WORDS (offsetof(struct GGGGC_PoolOld, start)/sizeof(ggc_size_t))
+
+/* pools in the run of a large object of this many words */
+#define LARGE_POOL_CT(size) \
+    ((POOLOLD_HEADER_WORDS + (size) + GGGGC_WORDS_PER_POOL - 1) / GGGGC_WORDS_PER_POOL)
+
+/* put a large object in a run of pools of its own, the first of which has an
+ * old pool's header, so that it's marked and remembered like an old object.
+ * It isn't zeroed or given its descriptor. With ggggc_allocLock held */
+static ggc_size_t *mallocLarge(struct GGGGC_Descriptor *descriptor)
+{
+    struct GGGGC_PoolOld *pool;
+    ggc_size_t ct, limit, w, words, *ret;
+
+    ct = LARGE_POOL_CT(descriptor->size);
+
+    /* only the first pool has a remember set and cards, and the rest have
+     * no header for GEN_OF(), so there can be no pointers past it */
+    if (ct > 1 && (descriptor->pointers[0] & 1)) {
+        limit = GGGGC_WORDS_PER_POOL - POOLOLD_HEADER_WORDS;
+        words = GGGGC_DESCRIPTOR_WORDS_REQ(descriptor->size);
+        for (w = limit/GGGGC_BITS_PER_WORD; w < words; w++) {
+            if (w == limit/GGGGC_BITS_PER_WORD ?
+                (descriptor->pointers[w] >> (limit%GGGGC_BITS_PER_WORD)) != 0 :
+                descriptor->pointers[w] != 0) {
+                fprintf(stderr, "GGGGC: an object with pointers can't be bigger than a pool (see GGGGC_LARGE_OBJECT_WORDS)\n");
+                abort();
+            }
+        }
+    }
+
+    if (ct == 1) {
+        pool = (struct GGGGC_PoolOld *) reusePool(1);
+    }
+    else if (!(pool = (struct GGGGC_PoolOld *) takeRun(ct))) {
+        pool = (struct GGGGC_PoolOld *) allocPools(ct, 1);
+        reservedPoolCt += ct;
+        preparePool((unsigned char *) pool, ct*GGGGC_POOL_BYTES);
+    }
+    GGGGC_SET_GEN(pool, GEN_OF_OLD);
+#ifdef GGGGC_HEAP_RESERVE
+    /* the rest is old too */
+    for (w = 1; w < ct; w++) {
+        ggggc_poolGens[GGGGC_POOL_INDEX(pool) + w] = (unsigned char) GEN_OF_OLD;
+    }
+#endif
+    clearPoolOld(pool);
+    ret = pool->start;
+    pool->free = ret + descriptor->size;
+    pool->end = (ggc_size_t *) pool + ct*GGGGC_WORDS_PER_POOL;
+    GGGGC_NOTE_START(ret);
+
+    pool->next = largeHead;
+    largeHead = pool;
+    pCtLarge += ct;
+    largeGrowth += ct;
+
+#ifdef GGGGC_CONCURRENT_MARK
+    /* allocated past the snapshot, so it's live */
+    if (ggggc_marking) {
+        pool->markBitmap[0] = 1;
+    }
+#endif
+
+    /* an old object with a young descriptor */
+    if (GEN_OF(descriptor) != GEN_OF_OLD) {
+        setRememberSet(ret);
+    }
+
+    return ret;
+}
+#endif
+
+/* refill this thread's TLAB from B0 and allocate from it, collecting if B0 is
+ * full. Objects bigger than a TLAB get one of exactly their size */
+static void *mallocSlow(struct GGGGC_Descriptor *descriptor)
+{
+    struct GGGGC_Descriptor *heapDescriptor;
+    ggc_size_t *ret = NULL, avail, tlabSize;
+
+    if (!ggggc_thread.registered) {
+        ggggc_registerThread();
+    }
+
+    /* another thread may collect while we wait for the lock, so the
+     * descriptor must be rooted, unless it's the temporary one of a
+     * self-describing descriptor descriptor, which isn't in the heap. It's
+     * set before the push, since pushing may yield */
+    heapDescriptor = descriptor->header.descriptor__ptr ? descriptor : NULL;
+    GGC_PUSH_1(heapDescriptor);
+
+    ggc_mutex_lock(&ggggc_allocLock);
     if (!b0Cur) {
         initialize();
     }
+    if (heapDescriptor) {
+        descriptor = heapDescriptor;
+    }
 
-    /* round up size to the nearest even number for freeobj */
-    descriptor->size = (descriptor->size + 1) & ~1;
+#ifndef GGGGC_NO_LARGE_OBJECTS
+    if (descriptor->size >= GGGGC_LARGE_OBJECT_WORDS) {
+        /* the large object space is collected with the old gen, once it's
+         * grown by as many pools as it and the old gen had */
+        if (largeGrowth + LARGE_POOL_CT(descriptor->size) > lCtLarge + pCtOld) {
+            ggggc_collectFullLocked();
+            if (heapDescriptor) {
+                descriptor = heapDescriptor;
+            }
+        }
+        ret = mallocLarge(descriptor);
+        ggc_mutex_unlock(&ggggc_allocLock);
+
+        memset(ret, 0, (descriptor->size)*sizeof(ggc_size_t));
+        ((struct GGGGC_Header *)ret)->descriptor__ptr = descriptor;
+        return ret;
+    }
+#endif
 
     retry:
-    
+    ggggc_retireTLAB(&ggggc_thread);
+
     /* bump pointer in B0 */
     while (1) {
-        if ((b0Cur->end - b0Cur->free) >= descriptor->size) {
+        avail = b0Cur->end - b0Cur->free;
+        if (avail >= descriptor->size) {
+            tlabSize = GGGGC_TLAB_WORDS;
+            if (tlabSize < descriptor->size) tlabSize = descriptor->size;
+            if (tlabSize > avail) tlabSize = avail;
             ret = b0Cur->free;
-            b0Cur->free += descriptor->size;
-            memset(ret, 0, (descriptor->size)*sizeof(ggc_size_t));
-            ((struct GGGGC_Header *)ret)->descriptor__ptr = descriptor;
-            return ret;
+            b0Cur->free += tlabSize;
+            ggggc_thread.tlabFree = ret + descriptor->size;
+            ggggc_thread.tlabEnd = ret + tlabSize;
+            break;
         }
         if (b0Cur->next) {
             b0Cur = b0Cur->next;
         }
         else {
-            break;
+            /* if B0 is full, run a collection, get the correct descriptor and retry malloc */
+            ggggc_collectLocked();
+
+            if (heapDescriptor) {
+                descriptor = heapDescriptor;
+            }
+
+            goto retry;
         }
     }
+    ggc_mutex_unlock(&ggggc_allocLock);
 
-    /* if B0 is full, run a collection, get the correct descriptor and retry malloc */
-    ggggc_collect();
+    memset(ret, 0, (descriptor->size)*sizeof(ggc_size_t));
+    ((struct GGGGC_Header *)ret)->descriptor__ptr = descriptor;
+    return ret;
+}
 
-    if (forwarded((ggc_size_t *)descriptor)) {
-        descriptor = (struct GGGGC_Descriptor *)forwardingAddress((ggc_size_t *)descriptor);
+void *ggggc_malloc(struct GGGGC_Descriptor *descriptor)
+{
+    ggc_size_t *ret;
+
+    /* round up size to the nearest even number for freeobj (only written
+     * when needed, since descriptors are shared between threads) */
+    if (descriptor->size & 1) {
+        descriptor->size++;
     }
 
-    goto retry;
+    /* bump pointer in this thread's TLAB, which needs no lock */
+    if ((ggc_size_t)(ggggc_thread.tlabEnd - ggggc_thread.tlabFree) >= descriptor->size) {
+        ret = ggggc_thread.tlabFree;
+        ggggc_thread.tlabFree += descriptor->size;
+        memset(ret, 0, (descriptor->size)*sizeof(ggc_size_t));
+        ((struct GGGGC_Header *)ret)->descriptor__ptr = descriptor;
+        return ret;
+    }
+
+    return mallocSlow(descriptor);
 }
 
 void *ggggc_mallocB1(struct GGGGC_Descriptor *descriptor)
@@ -331,10 +832,214 @@ void *ggggc_mallocB1(struct GGGGC_Descriptor *descriptor)
     goto retry;
 }
 
+/* sweep another old pool onto the freelists, if any are left to sweep */
+static int sweepMore()
+{
+#ifdef GGGGC_LAZY_SWEEP
+    return ggggc_sweepNext();
+#else
+    return 0;
+#endif
+}
+#ifdef GGGGC_IMMIX_OLD
+/* forget every hole, for a sweep to find them again */
+void ggggc_clearFreelists()
+{
+    holes = holesTail = NULL;
+    holeFree = holeEnd = NULL;
+}
+
+/* put a free run, whose selfend is set, after the other holes. A sweep
+ * finds them in address order, so that's the order they're bumped through */
+void ggggc_pushFreeRun(struct GGGGC_Freeobj *fo)
+{
+    fo->next = NULL;
+    if (holesTail) {
+        holesTail->next = fo;
+    }
+    else {
+        holes = fo;
+    }
+    holesTail = fo;
+}
+
+/* make sure the hole being bumped through has at least size words left,
+ * moving on to the next that does, and returns 0 if there's none. What's
+ * left of a hole moved on from stays a free run until the next sweep. As
+ * in Immix, a medium object (bigger than a line) that doesn't fit in what's
+ * left overflows to the bump space instead, unless overflow is 0 */
+static int nextHole(ggc_size_t size, int overflow)
+{
+    struct GGGGC_Freeobj *fo;
+
+    while ((ggc_size_t)(holeEnd - holeFree) < size) {
+        if (overflow && size > GGGGC_WORDS_PER_LINE && holeFree < holeEnd) {
+            return 0;
+        }
+        if (!holes && !sweepMore()) {
+            return 0;
+        }
+        if ((fo = holes)) {
+            holes = fo->next;
+            if (!holes) {
+                holesTail = NULL;
+            }
+            holeFree = (ggc_size_t *)fo;
+            holeEnd = holeFree + getFoSize(fo);
+        }
+    }
+    return 1;
+}
+
+/* bump size words out of the hole, which must have them. Its start is
+ * already noted, and what's left of it is made a free run, so that the pool
+ * stays walkable */
+static ggc_size_t *holeAlloc(ggc_size_t size)
+{
+    ggc_size_t *ret = holeFree;
+    struct GGGGC_Freeobj *rest;
+
+    holeFree += size;
+    if (holeFree < holeEnd) {
+        rest = (struct GGGGC_Freeobj *)holeFree;
+        rest->selfend = (ggc_size_t *)((ggc_size_t)(holeEnd - 1) | 2);
+        GGGGC_NOTE_START(rest);
+    }
+#ifdef GGGGC_EVACUATE_OLD
+    GGGGC_POOLOLD_OF(ret)->survivors += size;
+#endif
+    return ret;
+}
+
+/* an object from the holes, or NULL */
+static ggc_size_t *mallocHole(ggc_size_t size, int overflow)
+{
+    if (!nextHole(size, overflow)) {
+        return NULL;
+    }
+    oldFromFreelist = 1;
+    return holeAlloc(size);
+}
+
+#else
+/* the index of the highest set bit of a nonzero word */
+static ggc_size_t highestBit(ggc_size_t bits)
+{
+#ifdef __GNUC__
+    return 8*sizeof(unsigned long long) - 1 - __builtin_clzll((unsigned long long) bits);
+#else
+    ggc_size_t i = 0;
+    while (bits >>= 1) {
+        i++;
+    }
+    return i;
+#endif
+}
+
+/* the freelist for free runs of a size: one for each size up to
+ * GGGGC_FREELIST_SMALL_WORDS, then one for each power of 2 */
+static ggc_size_t freelistOf(ggc_size_t size)
+{
+    if (size <= GGGGC_FREELIST_SMALL_WORDS) {
+        return size/2 - 1;
+    }
+    return GGGGC_FREELIST_SMALL_WORDS/2 + highestBit(size) - highestBit(GGGGC_FREELIST_SMALL_WORDS);
+}
+
+/* the first non-empty freelist from i on, or GGGGC_FREELIST_BINS */
+static ggc_size_t nextFreelist(ggc_size_t i)
+{
+    ggc_size_t w = i/GGGGC_BITS_PER_WORD, bits;
+
+    if (i >= GGGGC_FREELIST_BINS) {
+        return GGGGC_FREELIST_BINS;
+    }
+    bits = freelistsUsed[w] & ((ggc_size_t)-1 << (i%GGGGC_BITS_PER_WORD));
+    while (!bits) {
+        if (++w*GGGGC_BITS_PER_WORD >= GGGGC_FREELIST_BINS) {
+            return GGGGC_FREELIST_BINS;
+        }
+        bits = freelistsUsed[w];
+    }
+    i = w*GGGGC_BITS_PER_WORD;
+    while (!(bits & 1)) {
+        bits >>= 1;
+        i++;
+    }
+    return i;
+}
+
+/* empty every freelist, for a sweep to rebuild them */
+void ggggc_clearFreelists()
+{
+    memset(freelists, 0, sizeof(freelists));
+    memset(freelistsUsed, 0, sizeof(freelistsUsed));
+}
+
+/* put a free run, whose selfend is set, on its freelist */
+void ggggc_pushFreeRun(struct GGGGC_Freeobj *fo)
+{
+    ggc_size_t i = freelistOf(getFoSize(fo));
+
+    fo->next = freelists[i];
+    freelists[i] = fo;
+    freelistsUsed[i/GGGGC_BITS_PER_WORD] |= (ggc_size_t)1 << (i%GGGGC_BITS_PER_WORD);
+}
+
+static struct GGGGC_Freeobj *popFreelist(ggc_size_t i)
+{
+    struct GGGGC_Freeobj *fo = freelists[i];
+
+    freelists[i] = fo->next;
+    if (!freelists[i]) {
+        freelistsUsed[i/GGGGC_BITS_PER_WORD] &= ~((ggc_size_t)1 << (i%GGGGC_BITS_PER_WORD));
+    }
+    return fo;
+}
+
+/* take a free run of at least size words off the freelists, NULL if there
+ * isn't one. Every run on a bigger freelist fits, so one of those is taken
+ * when there is one, and only otherwise are runs of size's own searched */
+static struct GGGGC_Freeobj *takeFreeRun(ggc_size_t size)
+{
+    ggc_size_t i = freelistOf(size), j;
+    struct GGGGC_Freeobj **fo, *ret;
+
+    /* every run of a small size's own fits too */
+    if (size <= GGGGC_FREELIST_SMALL_WORDS || size == (ggc_size_t)1 << highestBit(size)) {
+        j = nextFreelist(i);
+    }
+    else {
+        j = nextFreelist(i + 1);
+    }
+    if (j < GGGGC_FREELIST_BINS) {
+        return popFreelist(j);
+    }
+
+    if (size > GGGGC_FREELIST_SMALL_WORDS) {
+        for (fo = &freelists[i]; *fo; fo = &(*fo)->next) {
+            if (getFoSize(*fo) >= size) {
+                ret = *fo;
+                *fo = ret->next;
+                if (!freelists[i]) {
+                    freelistsUsed[i/GGGGC_BITS_PER_WORD] &= ~((ggc_size_t)1 << (i%GGGGC_BITS_PER_WORD));
+                }
+                return ret;
+            }
+            freelisthops++;
+        }
+    }
+    return NULL;
+}
+
+#endif
+
 void *ggggc_mallocOld(struct GGGGC_Descriptor *descriptor)
 {
-    ggc_size_t *ret = NULL, foSize;
-    struct GGGGC_Freeobj *curFo, *newFo;
+    ggc_size_t *ret = NULL;
+#ifndef GGGGC_IMMIX_OLD
+    struct GGGGC_Freeobj *fo, *newFo;
+#endif
 
     retry:
 
@@ -344,31 +1049,33 @@ void *ggggc_mallocOld(struct GGGGC_Descriptor *descriptor)
     }
 
     /* no need to zero space or set header either */
-    /* try freelist */
-    if (!skipFreelist && freelist) {
+#ifdef GGGGC_IMMIX_OLD
+    /* try holes */
+    if (!skipFreelist && (ret = mallocHole(descriptor->size, 1))) {
+        return ret;
+    }
+#else
+    /* try freelists */
+    if (!skipFreelist) {
         freelisthops = 0;
-        curFo = freelist;
-        while (curFo->next) {
-            foSize = getFoSize(curFo->next);
-            if (foSize > descriptor->size) {
-                ret = (ggc_size_t *)(curFo->next);
+        while (!(fo = takeFreeRun(descriptor->size)) && sweepMore());
+        if (fo) {
+            ret = (ggc_size_t *)fo;
+            if (getFoSize(fo) > descriptor->size) {
+                /* the rest stays free */
                 newFo = (struct GGGGC_Freeobj *)(ret + descriptor->size);
-                newFo->next = curFo->next->next;
-                newFo->selfend = curFo->next->selfend;
-                curFo->next = newFo;
-                return ret;
-            }
-            else if (foSize == descriptor->size) {
-                ret = (ggc_size_t *)(curFo->next);
-                curFo->next = curFo->next->next;
-                return ret;
-            }
-            else {
-                freelisthops++;
-                curFo = curFo->next;
+                newFo->selfend = fo->selfend;
+                GGGGC_NOTE_START(newFo);
+                ggggc_pushFreeRun(newFo);
             }
+            oldFromFreelist = 1;
+#ifdef GGGGC_EVACUATE_OLD
+            GGGGC_POOLOLD_OF(ret)->survivors += descriptor->size;
+#endif
+            return ret;
         }
     }
+#endif
     skipFreelist = 0;
 
     /* try freespace */
@@ -376,6 +1083,11 @@ void *ggggc_mallocOld(struct GGGGC_Descriptor *descriptor)
         if ((oldCur->end - oldCur->free) >= descriptor->size) {
             ret = oldCur->free;
             oldCur->free += descriptor->size;
+            GGGGC_NOTE_START(ret);
+            oldFromFreelist = 0;
+#ifdef GGGGC_EVACUATE_OLD
+            oldCur->survivors += descriptor->size;
+#endif
             return ret;
         }
         if (oldCur->next) {
@@ -386,6 +1098,13 @@ void *ggggc_mallocOld(struct GGGGC_Descriptor *descriptor)
         }
     }
 
+#ifdef GGGGC_IMMIX_OLD
+    /* a medium object that overflowed may still fit in a later hole */
+    if ((ret = mallocHole(descriptor->size, 0))) {
+        return ret;
+    }
+#endif
+
     if (inCollectFull) {
         /* if is in a re-try young collect, get new pools directly and retry malloc */
         mustAllocPool = 1;
@@ -397,6 +1116,139 @@ void *ggggc_mallocOld(struct GGGGC_Descriptor *descriptor)
     }
 }
 
+/* PLABs are kept to an even size, like objects, so that what's left of one
+ * can become a free run */
+static ggc_size_t plabSize(ggc_size_t minSize, ggc_size_t avail)
+{
+    ggc_size_t size = GGGGC_PLAB_WORDS;
+    if (size < minSize) size = minSize;
+    if (size > avail) size = avail & ~(ggc_size_t)1;
+    return size;
+}
+
+/* get a PLAB in B1 tospace of at least minSize words, by a GC worker holding
+ * ggggc_plabLock. Its size goes in *size */
+void *ggggc_mallocB1PLAB(ggc_size_t minSize, ggc_size_t *size)
+{
+    ggc_size_t *ret = NULL, avail;
+
+    retry:
+
+    if (mustAllocPool) {
+        ggggc_expandB1(1);
+        mustAllocPool = 0;
+    }
+
+    while (1) {
+        avail = b1ToCur->end - b1ToCur->free;
+        if (avail >= minSize) {
+            *size = plabSize(minSize, avail);
+            ret = b1ToCur->free;
+            b1ToCur->free += *size;
+            return ret;
+        }
+        if (b1ToCur->next) {
+            b1ToCur = b1ToCur->next;
+        }
+        else {
+            break;
+        }
+    }
+
+    mustAllocPool = 1;
+
+    goto retry;
+}
+
+/* and one in the old gen, from a free run big enough for a whole PLAB if
+ * there is one. NULL if the old gen is full, as ggggc_mallocOld() */
+void *ggggc_mallocOldPLAB(ggc_size_t minSize, ggc_size_t *size)
+{
+    ggc_size_t *ret = NULL, avail;
+#ifndef GGGGC_IMMIX_OLD
+    ggc_size_t foSize;
+    struct GGGGC_Freeobj *fo, *newFo;
+#endif
+
+    retry:
+
+    if (mustAllocPool) {
+        ggggc_expandOld(1);
+        mustAllocPool = 0;
+    }
+
+#ifdef GGGGC_IMMIX_OLD
+    /* try holes */
+    if (!skipFreelist && nextHole(minSize, 1)) {
+        *size = plabSize(minSize, holeEnd - holeFree);
+        return holeAlloc(*size);
+    }
+#else
+    /* try freelists */
+    if (!skipFreelist) {
+        freelisthops = 0;
+        do {
+            fo = takeFreeRun(plabSize(minSize, (ggc_size_t)-1));
+            if (!fo) {
+                fo = takeFreeRun(minSize);
+            }
+        } while (!fo && sweepMore());
+        if (fo) {
+            ret = (ggc_size_t *)fo;
+            foSize = getFoSize(fo);
+            *size = plabSize(minSize, foSize);
+            if (*size < foSize) {
+                newFo = (struct GGGGC_Freeobj *)(ret + *size);
+                newFo->selfend = fo->selfend;
+                GGGGC_NOTE_START(newFo);
+                ggggc_pushFreeRun(newFo);
+            }
+#ifdef GGGGC_EVACUATE_OLD
+            GGGGC_POOLOLD_OF(ret)->survivors += *size;
+#endif
+            return ret;
+        }
+    }
+#endif
+    skipFreelist = 0;
+
+    /* try freespace */
+    while (1) {
+        avail = oldCur->end - oldCur->free;
+        if (avail >= minSize) {
+            *size = plabSize(minSize, avail);
+            ret = oldCur->free;
+            oldCur->free += *size;
+#ifdef GGGGC_EVACUATE_OLD
+            oldCur->survivors += *size;
+#endif
+            return ret;
+        }
+        if (oldCur->next) {
+            oldCur = oldCur->next;
+        }
+        else {
+            break;
+        }
+    }
+
+#ifdef GGGGC_IMMIX_OLD
+    if (nextHole(minSize, 0)) {
+        *size = plabSize(minSize, holeEnd - holeFree);
+        return holeAlloc(*size);
+    }
+#endif
+
+    if (inCollectFull) {
+        mustAllocPool = 1;
+        skipFreelist = 1;
+        goto retry;
+    }
+    else {
+        return NULL;
+    }
+}
+
 struct GGGGC_Array {
     struct GGGGC_Header header;
     ggc_size_t length;
@@ -405,8 +1257,13 @@ struct GGGGC_Array {
 /* allocate a pointer array (size is in words) */
 void *ggggc_mallocPointerArray(ggc_size_t sz)
 {
-    struct GGGGC_Descriptor *descriptor = ggggc_allocateDescriptorPA(sz + 1 + sizeof(struct GGGGC_Header)/sizeof(ggc_size_t));
-    struct GGGGC_Array *ret = (struct GGGGC_Array *) ggggc_malloc(descriptor);
+    struct GGGGC_Descriptor *descriptor = NULL;
+    struct GGGGC_Array *ret = NULL;
+
+    GGC_PUSH_2(descriptor, ret);
+
+    descriptor = ggggc_allocateDescriptorPA(sz + 1 + sizeof(struct GGGGC_Header)/sizeof(ggc_size_t));
+    ret = (struct GGGGC_Array *) ggggc_malloc(descriptor);
     ret->length = sz;
     return ret;
 }
@@ -429,7 +1286,7 @@ void *ggggc_mallocDataArray(ggc_size_t nmemb, ggc_size_t size)
 /* allocate a descriptor-descriptor for a descriptor of the given size */
 struct GGGGC_Descriptor *ggggc_allocateDescriptorDescriptor(ggc_size_t size)
 {
-    struct GGGGC_Descriptor tmpDescriptor, *ret;
+    struct GGGGC_Descriptor tmpDescriptor, *dd, *ret;
     ggc_size_t ddSize;
 
     /* need one description bit for every word in the object */
@@ -439,30 +1296,48 @@ struct GGGGC_Descriptor *ggggc_allocateDescriptorDescriptor(ggc_size_t size)
     if (ggggc_descriptorDescriptors[size])
         return ggggc_descriptorDescriptors[size];
 
+    /* unless it describes itself, the descriptor descriptor needs its own
+     * descriptor, got first so the lock isn't taken twice and so a
+     * collection never sees it with the temporary one */
+    dd = NULL;
+    if (ddSize != size) {
+        dd = ggggc_allocateDescriptorDescriptor(ddSize);
+    }
+
     /* otherwise, need to allocate one. First lock the space */
+    ggc_mutex_lock(&ggggc_descriptorDescriptorsLock);
     if (ggggc_descriptorDescriptors[size]) {
+        ggc_mutex_unlock(&ggggc_descriptorDescriptorsLock);
         return ggggc_descriptorDescriptors[size];
     }
 
     /* now make a temporary descriptor to describe the descriptor descriptor */
     tmpDescriptor.header.descriptor__ptr = NULL;
     tmpDescriptor.size = ddSize;
+    tmpDescriptor.shape = GGGGC_SHAPE_BITMAP;
+    tmpDescriptor.tracer = NULL;
     tmpDescriptor.pointers[0] = GGGGC_DESCRIPTOR_DESCRIPTION;
 
     /* allocate the descriptor descriptor */
-    ret = (struct GGGGC_Descriptor *) ggggc_malloc(&tmpDescriptor);
+    if (dd == NULL) {
+        ret = (struct GGGGC_Descriptor *) ggggc_malloc(&tmpDescriptor);
+        ret->header.descriptor__ptr = ret;
+    }
+    else {
+        ret = (struct GGGGC_Descriptor *) ggggc_malloc(dd);
+    }
 
     /* make it correct */
     ret->size = size;
+    ret->shape = GGGGC_SHAPE_BITMAP;
+    ret->tracer = NULL;
     ret->pointers[0] = GGGGC_DESCRIPTOR_DESCRIPTION;
 
     /* put it in the list */
     ggggc_descriptorDescriptors[size] = ret;
     GGC_PUSH_1(ggggc_descriptorDescriptors[size]);
     GGC_GLOBALIZE();
-
-    /* and give it a proper descriptor */
-    ggggc_descriptorDescriptors[size]->header.descriptor__ptr = ggggc_allocateDescriptorDescriptor(ddSize);
+    ggc_mutex_unlock(&ggggc_descriptorDescriptorsLock);
 
     return ggggc_descriptorDescriptors[size];
 }
@@ -476,6 +1351,48 @@ struct GGGGC_Descriptor *ggggc_allocateDescriptor(ggc_size_t size, ggc_size_t po
     return ggggc_allocateDescriptorL(size, pointersA);
 }
 
+/* how the collector should find the pointers an object of size words has,
+ * from its bitmap: GGGGC_SHAPE_NONE if the header's the only one,
+ * GGGGC_SHAPE_ARRAY if every word after the second is one, as in a pointer
+ * array, and otherwise GGGGC_SHAPE_BITMAP */
+static ggc_size_t shapeOf(ggc_size_t size, const ggc_size_t *pointers)
+{
+    ggc_size_t words = GGGGC_DESCRIPTOR_WORDS_REQ(size), w, mask, bits;
+    int none = 1, dense = 1;
+
+    for (w = 0; w < words; w++) {
+        mask = (ggc_size_t)-1;
+        if ((w + 1)*GGGGC_BITS_PER_WORD > size) {
+            mask = ((ggc_size_t)1 << (size % GGGGC_BITS_PER_WORD)) - 1;
+        }
+        if (w == 0) {
+            /* not the header, and a pointer array's length isn't a pointer */
+            mask &= ~(ggc_size_t)1;
+            bits = pointers[0] & mask;
+            if (bits != (mask & ~(ggc_size_t)2)) {
+                dense = 0;
+            }
+        }
+        else {
+            bits = pointers[w] & mask;
+            if (bits != mask) {
+                dense = 0;
+            }
+        }
+        if (bits) {
+            none = 0;
+        }
+    }
+
+    if (none) {
+        return GGGGC_SHAPE_NONE;
+    }
+    else if (dense) {
+        return GGGGC_SHAPE_ARRAY;
+    }
+    return GGGGC_SHAPE_BITMAP;
+}
+
 /* descriptor allocator when more than one word is required to describe the
  * pointers */
 struct GGGGC_Descriptor *ggggc_allocateDescriptorL(ggc_size_t size, const ggc_size_t *pointers)
@@ -496,13 +1413,16 @@ struct GGGGC_Descriptor *ggggc_allocateDescriptorL(ggc_size_t size, const ggc_si
     /* use that to allocate the descriptor */
     ret = (struct GGGGC_Descriptor *) ggggc_malloc(dd);
     ret->size = size;
+    ret->tracer = NULL;
 
     /* and set it up */
     if (pointers) {
         memcpy(ret->pointers, pointers, sizeof(ggc_size_t) * dPWords);
         ret->pointers[0] |= 1; /* first word is always the descriptor pointer */
+        ret->shape = shapeOf(size, ret->pointers);
     } else {
         ret->pointers[0] = 0;
+        ret->shape = GGGGC_SHAPE_NONE;
     }
 
     return ret;
@@ -522,7 +1442,7 @@ struct GGGGC_Descriptor *ggggc_allocateDescriptorPA(ggc_size_t size)
     /* get rid of non-pointers */
     pointers[0] &= ~0x2;
 
-    /* and allocate */
+    /* and allocate, which finds it's a dense range of pointers */
     return ggggc_allocateDescriptorL(size, pointers);
 }
 
@@ -537,15 +1457,22 @@ struct GGGGC_Descriptor *ggggc_allocateDescriptorDA(ggc_size_t size)
 struct GGGGC_Descriptor *ggggc_allocateDescriptorSlot(struct GGGGC_DescriptorSlot *slot)
 {
     if (slot->descriptor) return slot->descriptor;
+    ggc_mutex_lock(&ggggc_descriptorSlotsLock);
     if (slot->descriptor) {
+        ggc_mutex_unlock(&ggggc_descriptorSlotsLock);
         return slot->descriptor;
     }
 
     slot->descriptor = ggggc_allocateDescriptor(slot->size, slot->pointers);
+    if (slot->tracer && slot->descriptor->shape == GGGGC_SHAPE_BITMAP) {
+        slot->descriptor->tracer = slot->tracer;
+        slot->descriptor->shape = GGGGC_SHAPE_TRACER;
+    }
 
     /* make the slot descriptor a root */
     GGC_PUSH_1(slot->descriptor);
     GGC_GLOBALIZE();
+    ggc_mutex_unlock(&ggggc_descriptorSlotsLock);
 
     return slot->descriptor;
 }
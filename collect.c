@@ -21,6 +21,12 @@
 #include <string.h>
 #include <sys/types.h>
 
+#if !defined(GGGGC_NO_SIMD) && !defined(GGGGC_NO_GNUC_FEATURES) && \
+    defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define GGGGC_SIMD_X86 1
+#include <immintrin.h>
+#endif
+
 #include "ggggc/gc.h"
 #include "ggggc-internals.h"
 
@@ -31,6 +37,7 @@ extern "C" {
 /*******************************************************************************************/
 /* functions */
 
+#ifndef GGGGC_PARALLEL_COLLECT
 static void mark(ggc_size_t *obj)
 {
     *obj |= 1;
@@ -40,6 +47,7 @@ static void unmark(ggc_size_t *obj)
 {
     *obj &= ~1;
 }
+#endif
 
 static int isMarked(ggc_size_t *obj)
 {
@@ -51,11 +59,6 @@ static void markFo(struct GGGGC_Freeobj *obj)
     obj->selfend = (ggc_size_t*)((ggc_size_t)obj->selfend | 2);
 }
 
-static void unmarkFo(struct GGGGC_Freeobj *obj)
-{
-    obj->selfend = (ggc_size_t*)((ggc_size_t)obj->selfend & ~2);
-}
-
 static int isMarkedFo(struct GGGGC_Freeobj *obj)
 {
     return (ggc_size_t)obj->selfend & 2;
@@ -76,10 +79,12 @@ ggc_size_t *forwardingAddress(ggc_size_t *fromRef)
 	return (ggc_size_t *)(*fromRef & ~7);
 }
 
+#if !defined(GGGGC_PARALLEL_COLLECT) || defined(GGGGC_COMPACT_OLD)
 static void setForwardingAddress(ggc_size_t *fromRef, ggc_size_t *toRef)
 {
 	*(ggc_size_t **)fromRef = (ggc_size_t *)((ggc_size_t)toRef | 4);
 }
+#endif
 
 /* if child is forwarded, get the forwarding address */
 static ggc_size_t *getCorrectChild(ggc_size_t *child)
@@ -96,22 +101,65 @@ static ggc_size_t *getCorrectChild(ggc_size_t *child)
     }
 }
 
+/* size of an object in a pool being walked, which may be marked, forwarded
+ * or a free run */
+static ggc_size_t walkSize(ggc_size_t *ptr)
+{
+    if (isMarkedFo((struct GGGGC_Freeobj *)ptr)) {
+        return getFoSize((struct GGGGC_Freeobj *)ptr);
+    }
+    if (forwarded(ptr)) {
+        /* the copy has the same shape */
+        ptr = forwardingAddress(ptr);
+    }
+    return ((struct GGGGC_Descriptor *)(*ptr & ~7))->size;
+}
+
+#ifdef GGGGC_CARD_TABLE
+void setRememberSet(ggc_size_t *loc)
+{
+	GGGGC_POOLOLD_OF(loc)->cards[GGGGC_CARD_OF(loc)] = 1;
+}
+
+static void clearRememberSet()
+{
+	struct GGGGC_PoolOld *tempPool;
+	for (tempPool = oldHead; tempPool != oldCur->next; tempPool = tempPool->next) {
+		memset(tempPool->cards, 0, GGGGC_CARDS_PER_POOL);
+	}
+	for (tempPool = largeHead; tempPool; tempPool = tempPool->next) {
+		memset(tempPool->cards, 0, GGGGC_CARDS_PER_POOL);
+	}
+}
+
+#else
+/* a remembered slot sets its bit in the remember set, and the remember set
+ * word's bit in the summary, so that a young collect can skip the empty
+ * words in bulk */
 void setRememberSet(ggc_size_t *loc)
 {
-	ggc_size_t offset, rememberSetIndex;
+	ggc_size_t offset, rememberSetIndex, bit, summaryBit;
 	struct GGGGC_PoolOld *tempPool;
 
 	tempPool = GGGGC_POOLOLD_OF(loc);
 	offset = loc - tempPool->start;
 	rememberSetIndex = offset/GGGGC_BITS_PER_WORD;
-	tempPool->rememberSet[rememberSetIndex] |= ((ggc_size_t)1 << offset%GGGGC_BITS_PER_WORD);
+	bit = (ggc_size_t)1 << offset%GGGGC_BITS_PER_WORD;
+	summaryBit = (ggc_size_t)1 << rememberSetIndex%GGGGC_BITS_PER_WORD;
 
-	if (rememberSetIndex > tempPool->maxRememberSetIndex) {
-		tempPool->maxRememberSetIndex = rememberSetIndex;
+#if defined(__GNUC__) && !defined(GGGGC_NO_THREADS)
+	/* most slots are already remembered, so only pay for the atomics if
+	 * not. The summary bit is set after the slot's, see unremember() */
+	if (!(tempPool->rememberSet[rememberSetIndex] & bit)) {
+		__atomic_fetch_or(&tempPool->rememberSet[rememberSetIndex], bit, __ATOMIC_SEQ_CST);
 	}
-	if (rememberSetIndex < tempPool->minRememberSetIndex) {
-		tempPool->minRememberSetIndex = rememberSetIndex;
+	if (!(__atomic_load_n(&tempPool->rememberSummary[rememberSetIndex/GGGGC_BITS_PER_WORD], __ATOMIC_SEQ_CST) & summaryBit)) {
+		__atomic_fetch_or(&tempPool->rememberSummary[rememberSetIndex/GGGGC_BITS_PER_WORD], summaryBit, __ATOMIC_SEQ_CST);
 	}
+#else
+	tempPool->rememberSet[rememberSetIndex] |= bit;
+	tempPool->rememberSummary[rememberSetIndex/GGGGC_BITS_PER_WORD] |= summaryBit;
+#endif
 }
 
 static void clearRememberSet()
@@ -119,8 +167,14 @@ static void clearRememberSet()
 	struct GGGGC_PoolOld *tempPool;
 	for (tempPool = oldHead; tempPool != oldCur->next; tempPool = tempPool->next) {
 		memset(tempPool->rememberSet, 0, REMEMBERSET_SIZE*sizeof(ggc_size_t));
+		memset(tempPool->rememberSummary, 0, REMEMBERSUMMARY_SIZE*sizeof(ggc_size_t));
+	}
+	for (tempPool = largeHead; tempPool; tempPool = tempPool->next) {
+		memset(tempPool->rememberSet, 0, REMEMBERSET_SIZE*sizeof(ggc_size_t));
+		memset(tempPool->rememberSummary, 0, REMEMBERSUMMARY_SIZE*sizeof(ggc_size_t));
 	}
 }
+#endif
 
 static void swapB1Pools()
 {
@@ -159,361 +213,2495 @@ static void resetPools()
 	b1FromCur = b1FromHead;
 }
 
-/* functions */
-/*******************************************************************************************/
-/* ggggc_collect() */
-
-static void pushIfNeedWorklist(ggc_size_t **loc, char needToRemember)
+#if !defined(GGGGC_PARALLEL_COLLECT) || defined(GGGGC_CONCURRENT_MARK)
+/* put a fresh chunk on top of a worklist, taking a spare one if there is
+ * one, returns 0 if it's at its chunk limit or out of memory */
+static int growWorklist(struct GGGGC_Worklist *wl)
 {
-    /* save some unnecessary pushes here */
-	if (*loc != NULL && (GEN_OF(*loc) != GEN_OF_OLD)) {
-        if (GEN_OF(*loc) == GEN_OF_B1TO && !isMarked(*loc)) {
-            return;
+    struct GGGGC_WorklistChunk *chunk;
+
+    if (wl->spare) {
+        chunk = wl->spare;
+        wl->spare = chunk->next;
+    }
+    else {
+        if (wl->chunkLimit && wl->chunkCt >= wl->chunkLimit) {
+            return 0;
         }
-		if (forwarded(*loc)) {
-			ggc_size_t *toRef = forwardingAddress(*loc);
-			*loc = toRef;
-			if (needToRemember && (GEN_OF(toRef) != GEN_OF_OLD)) {
-				setRememberSet((ggc_size_t *)loc);
-			}
-		}
-		else {
-			struct GGGGC_Worklist *node = (struct GGGGC_Worklist *)malloc(sizeof(struct GGGGC_Worklist));
-		    node->loc = loc;
-		    node->needToRemember = needToRemember;
-		    node->next = worklist->next;
-		    worklist->next = node;
-		}
-	}
+        chunk = (struct GGGGC_WorklistChunk *)malloc(sizeof(struct GGGGC_WorklistChunk));
+        if (chunk == NULL) {
+            return 0;
+        }
+        wl->chunkCt++;
+    }
+    chunk->top = 0;
+    chunk->next = wl->chunk;
+    wl->chunk = chunk;
+    return 1;
 }
 
-static struct GGGGC_Worklist *popWorklist()
+/* push an entry onto a worklist, returns 0 if it couldn't grow */
+static int tryPushWorklist(struct GGGGC_Worklist *wl, ggc_size_t entry)
 {
-    if (worklist->next != NULL) {
-        struct GGGGC_Worklist *node = worklist->next;
-        worklist->next = worklist->next->next;
-        return node;
+    struct GGGGC_WorklistChunk *chunk = wl->chunk;
+
+    if (chunk == NULL || chunk->top == GGGGC_WORKLIST_CHUNK_SIZE) {
+        if (!growWorklist(wl)) {
+            return 0;
+        }
+        chunk = wl->chunk;
     }
-    return NULL;
+
+    chunk->entries[chunk->top++] = entry;
+    wl->pushCt++;
+    return 1;
 }
 
-static void freeWorklist()
+/* push an entry onto a worklist that must not fail */
+static void pushWorklist(struct GGGGC_Worklist *wl, ggc_size_t entry)
 {
-	struct GGGGC_Worklist *node;
-	while (worklist) {
-		node = worklist;
-		worklist = worklist->next;
-		free(node);
-	}
+    if (!tryPushWorklist(wl, entry)) {
+        perror("malloc");
+        abort();
+    }
 }
 
-static void initializeWorklist()
+/* pop an entry from a worklist, 0 if it's empty */
+static ggc_size_t popWorklist(struct GGGGC_Worklist *wl)
 {
-	ggc_size_t i, j, mask, **loc;
-	struct GGGGC_PoolOld *tempPool;
-	struct GGGGC_PointerStack *psCur;
+    struct GGGGC_WorklistChunk *chunk = wl->chunk;
 
-	worklist = (struct GGGGC_Worklist *)malloc(sizeof(struct GGGGC_Worklist));
-    worklist->next = NULL;
-
-    /* add refs of young gen in remember set */
-    for (tempPool = oldHead; tempPool != oldCur->next; tempPool = tempPool->next) {
-    	for (i = tempPool->minRememberSetIndex; i <= tempPool->maxRememberSetIndex; i++) {
-    		if (tempPool->rememberSet[i] != 0) {
-    			mask = 1;
-    			for (j = 0; j < GGGGC_BITS_PER_WORD; j++) {
-    				if (tempPool->rememberSet[i] & mask) {
-    					loc = (ggc_size_t **)(tempPool->start + i*GGGGC_BITS_PER_WORD + j);
-    					if (*loc != NULL && (GEN_OF(*loc) != GEN_OF_OLD)) {
-    						pushIfNeedWorklist(loc, 0);
-    					}
-    					else {
-                            /* reset wrongly remembered bit */
-    						tempPool->rememberSet[i] &= ~mask;
-    					}
-    				}
-    				mask <<= 1;
-    			}
-    		}
-    	}
+    while (chunk != NULL && chunk->top == 0) {
+        /* retire the empty chunk to the spares */
+        wl->chunk = chunk->next;
+        chunk->next = wl->spare;
+        wl->spare = chunk;
+        chunk = wl->chunk;
     }
-
-    /* add refs of young gen in roots */
-    for (psCur = ggggc_pointerStack; psCur; psCur = psCur->next) {
-        for (i = 0; i < psCur->size; i++) {
-        	pushIfNeedWorklist((ggc_size_t **)(psCur->pointers[i]), 0);
-        }
+    if (chunk == NULL) {
+        return 0;
     }
+    return chunk->entries[--chunk->top];
 }
+#endif
 
-static void scan(ggc_size_t *obj)
+/* discard everything on a worklist, keeping its chunks as spares */
+static void clearWorklist(struct GGGGC_Worklist *wl)
 {
-	ggc_size_t pWord, pBit, maxWord, maxBit, pCur;
-	char needToRemember;
-    struct GGGGC_Descriptor *dCur;
+    struct GGGGC_WorklistChunk *chunk;
 
-    if (GEN_OF(obj) == GEN_OF_OLD) {
-    	needToRemember = 1;
-    }
-    else {
-    	needToRemember = 0;
+    while (wl->chunk != NULL) {
+        chunk = wl->chunk;
+        wl->chunk = chunk->next;
+        chunk->next = wl->spare;
+        wl->spare = chunk;
     }
-    
-    dCur = ((struct GGGGC_Header *)obj)->descriptor__ptr;
-    if (dCur->pointers[0] & 1) {
-        maxWord = (dCur->size - 1)/GGGGC_BITS_PER_WORD;
-        for (pWord = 0; pWord <= maxWord; pWord++) {
-            pCur = dCur->pointers[pWord];
-            maxBit = (pWord == maxWord)?((dCur->size - 1)%GGGGC_BITS_PER_WORD):(GGGGC_BITS_PER_WORD);
-            for (pBit = 0; pBit <= maxBit; pBit++) {
-                if (pCur & 1) {
-                    pushIfNeedWorklist((ggc_size_t **)(obj + pWord*GGGGC_BITS_PER_WORD + pBit), needToRemember);
-                }
-                pCur >>= 1;
+}
+
+#if !defined(GGGGC_PARALLEL_COLLECT) || defined(GGGGC_COMPACT_OLD) || defined(GGGGC_CONCURRENT_MARK)
+/* call fn on every root: those on each thread's pointer stack, then the globals */
+static void forEachRoot(void (*fn)(ggc_size_t **loc))
+{
+    ggc_size_t i;
+    struct GGGGC_ThreadInfo *ti;
+    struct GGGGC_PointerStack *psCur;
+
+    for (ti = ggggc_threads; ti; ti = ti->next) {
+        for (psCur = *ti->pointerStack; psCur; psCur = psCur->next) {
+            for (i = 0; i < psCur->size; i++) {
+                fn((ggc_size_t **)(psCur->pointers[i]));
             }
         }
     }
-    else {
-        /* even if the object has no refs, still need to process it's first word */
-        pushIfNeedWorklist((ggc_size_t **)obj, needToRemember);
+    for (psCur = ggggc_pointerStackGlobals; psCur; psCur = psCur->next) {
+        for (i = 0; i < psCur->size; i++) {
+            fn((ggc_size_t **)(psCur->pointers[i]));
+        }
     }
 }
+#endif
 
-void ggggc_collect()
-{
-	ggc_size_t **loc, *fromRef, *toRef;
-	struct GGGGC_Worklist *node;
-	struct GGGGC_Descriptor *dCur;
-    int poolsNeed;
-
-    inCollect = 1;
-    lCtB1 = 0;
-    swapB1Pools();
+/* functions */
+/*******************************************************************************************/
+/* ggggc_collect() */
 
-    /* re-try young collect start here */
-    retry:
+#if defined(GGGGC_CHENEY_SCAN) || defined(GGGGC_PARALLEL_COLLECT)
+/* set when an object could not be promoted, so the scan must stop for a full collection */
+static volatile char promotionFailed;
+#endif
 
-	initializeWorklist();
-	while (node = popWorklist()) {
-		loc = node->loc;
-		fromRef = *loc;
-        /* need to do unmark job for re-try young collect */
-        if (GEN_OF(fromRef) == GEN_OF_B1TO) {
-            if (isMarked(fromRef)) {
-                /* obj is not scanned */
-                unmark(fromRef);
-                scan(fromRef);
-            }
-        }
-        else {
-            if (forwarded(fromRef)) {
-                toRef = forwardingAddress(fromRef);
-            }
-            else {
-                unmark(fromRef);
-                dCur = ((struct GGGGC_Header *)fromRef)->descriptor__ptr;
-                if (GEN_OF(fromRef) == GEN_OF_B0) {
-                    toRef = ggggc_mallocB1(dCur);
-                }
-                else if (GEN_OF(fromRef) == GEN_OF_B1FROM) {
-                    toRef = ggggc_mallocOld(dCur);
-                    if (toRef == NULL) {
-                        ggggc_collectFull();
-                        goto retry;
-                    }
-                    lCtB1 += dCur->size;
-                }
-                memcpy(toRef, fromRef, (dCur->size)*sizeof(ggc_size_t));
-                setForwardingAddress(fromRef, toRef);
-                scan(toRef);
-            }
-            /* update loc */
-            *loc = toRef;
-            if (node->needToRemember && (GEN_OF(toRef) != GEN_OF_OLD)) {
-                setRememberSet((ggc_size_t *)loc);
-            }
-        }
+#ifdef GGGGC_PARALLEL_COLLECT
+/* the worker this thread is, while a parallel young collect runs */
+static ggc_thread_local struct GGGGC_Worker *curWorker;
+#endif
 
-		free(node);
-	}
+/* old objects are marked in their pool's bitmap rather than their headers:
+ * marking doesn't write to the objects, clearing the marks is a memset, and
+ * young collects can rewrite old headers while a concurrent mark runs or
+ * before a lazy sweep gets to them */
+static int isBitmapMarked(ggc_size_t *obj)
+{
+    struct GGGGC_PoolOld *tempPool = GGGGC_POOLOLD_OF(obj);
+    ggc_size_t offset = obj - tempPool->start;
 
-    freeWorklist();
-    resetPools();
-    poolsNeed = (lCtB1 * 3)/GGGGC_WORDS_PER_POOL + 1 - pCtB1;
-    ggggc_expandB1(poolsNeed);
-    ggggc_expandB0();
-    inCollectFull = 0;
-    inCollect = 0;
+    return (tempPool->markBitmap[offset/GGGGC_BITS_PER_WORD] >> (offset%GGGGC_BITS_PER_WORD)) & 1;
 }
 
-/* ggggc_collect() */
-/*******************************************************************************************/
-/* ggggc_collectFull() */
-
-static void pushWorklistFull(ggc_size_t *obj)
+/* mark an old object in its bitmap, returns 1 if it wasn't marked already.
+ * Parallel workers may mark objects in the same word */
+static int bitmapMark(ggc_size_t *obj)
 {
-	struct GGGGC_WorklistFull *node = (struct GGGGC_WorklistFull *)malloc(sizeof(struct GGGGC_WorklistFull));
-    node->obj = obj;
-    node->next = worklistFull->next;
-    worklistFull->next = node;
+    struct GGGGC_PoolOld *tempPool = GGGGC_POOLOLD_OF(obj);
+    ggc_size_t offset = obj - tempPool->start;
+    ggc_size_t bit = (ggc_size_t)1 << (offset%GGGGC_BITS_PER_WORD);
+
+#if defined(__GNUC__) && !defined(GGGGC_NO_THREADS)
+    return !(__atomic_fetch_or(&tempPool->markBitmap[offset/GGGGC_BITS_PER_WORD], bit, __ATOMIC_RELAXED) & bit);
+#else
+    if (tempPool->markBitmap[offset/GGGGC_BITS_PER_WORD] & bit) {
+        return 0;
+    }
+    tempPool->markBitmap[offset/GGGGC_BITS_PER_WORD] |= bit;
+    return 1;
+#endif
 }
 
-static ggc_size_t *popWorklistFull()
+/* the index of the lowest set bit of a nonzero word */
+static ggc_size_t lowestBit(ggc_size_t bits)
 {
-    if (worklistFull->next != NULL) {
-        ggc_size_t *ret = worklistFull->next->obj;
-        struct GGGGC_WorklistFull *node = worklistFull->next;
-        worklistFull->next = worklistFull->next->next;
-        free(node);
-        return ret;
+#ifdef __GNUC__
+    return __builtin_ctzll((unsigned long long) bits);
+#else
+    ggc_size_t i = 0;
+    while (!(bits & 1)) {
+        bits >>= 1;
+        i++;
     }
-    return NULL;
+    return i;
+#endif
 }
 
-static void freeWorklistFull()
+/* word w of a descriptor's pointer bitmap, without any bits past the end of
+ * the object, so that its pointers can be found with lowestBit() */
+static ggc_size_t pointerWord(struct GGGGC_Descriptor *dCur, ggc_size_t w)
 {
-	struct GGGGC_WorklistFull *node;
-	while (worklistFull) {
-		node = worklistFull;
-		worklistFull = worklistFull->next;
-		free(node);
-	}
+    ggc_size_t pCur = dCur->pointers[w];
+
+    if ((w + 1)*GGGGC_BITS_PER_WORD > dCur->size) {
+        pCur &= ((ggc_size_t)1 << (dCur->size % GGGGC_BITS_PER_WORD)) - 1;
+    }
+    return pCur;
 }
 
-static void initializeWorklistFull()
+/* the first nonzero word of a bitmap from w up to end, or end if there's
+ * none. A sweep of a mostly dead pool spends its time here, so it's done
+ * with the widest vectors the CPU has, picked by ggggc_chooseBitmapScan() */
+static ggc_size_t firstNonzeroScalar(const ggc_size_t *bitmap, ggc_size_t w, ggc_size_t end)
 {
-	ggc_size_t *obj, i;
-	struct GGGGC_PointerStack *psCur;
+    while (w < end && !bitmap[w]) {
+        w++;
+    }
+    return w;
+}
 
-	worklistFull = (struct GGGGC_WorklistFull *)malloc(sizeof(struct GGGGC_WorklistFull));
-    worklistFull->next = NULL;
+#ifdef GGGGC_SIMD_X86
+/* 256 bits at a time */
+__attribute__((target("avx2")))
+static ggc_size_t firstNonzeroAVX2(const ggc_size_t *bitmap, ggc_size_t w, ggc_size_t end)
+{
+    __m256i v;
 
-    /* add refs in roots */
-    for (psCur = ggggc_pointerStack; psCur; psCur = psCur->next) {
-        for (i = 0; i < psCur->size; i++) {
-        	obj = getCorrectChild(*(ggc_size_t **)(psCur->pointers[i]));
-        	if (obj != NULL && !isMarked(obj)) {
-        		mark(obj);
-        		pushWorklistFull(obj);
-        	}
+    while (end - w >= 32/sizeof(ggc_size_t)) {
+        v = _mm256_loadu_si256((const __m256i *)(bitmap + w));
+        if (!_mm256_testz_si256(v, v)) {
+            break;
         }
+        w += 32/sizeof(ggc_size_t);
     }
+    return firstNonzeroScalar(bitmap, w, end);
 }
 
-static void scanFull(ggc_size_t *obj)
+/* 128 bits at a time */
+__attribute__((target("sse2")))
+static ggc_size_t firstNonzeroSSE2(const ggc_size_t *bitmap, ggc_size_t w, ggc_size_t end)
 {
-	ggc_size_t pWord, pBit, maxWord, maxBit, pCur, *child;
-    struct GGGGC_Descriptor *dCur;
+    __m128i v, zero = _mm_setzero_si128();
 
-    /* deal with the first word first */
-    child = getCorrectChild(*(ggc_size_t **)obj);
-    if (child != NULL && !isMarked(child)) {
-        mark(child);
-        pushWorklistFull(child);
+    while (end - w >= 16/sizeof(ggc_size_t)) {
+        v = _mm_loadu_si128((const __m128i *)(bitmap + w));
+        if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) != 0xFFFF) {
+            break;
+        }
+        w += 16/sizeof(ggc_size_t);
     }
-    if (child != NULL && GEN_OF(obj) == GEN_OF_OLD && GEN_OF(child) != GEN_OF_OLD) {
-        setRememberSet((ggc_size_t *)(obj));
+    return firstNonzeroScalar(bitmap, w, end);
+}
+#endif
+
+static ggc_size_t (*firstNonzero)(const ggc_size_t *bitmap, ggc_size_t w, ggc_size_t end) = firstNonzeroScalar;
+
+/* pick the bitmap scan for this CPU, before the first collection */
+void ggggc_chooseBitmapScan()
+{
+#ifdef GGGGC_SIMD_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        firstNonzero = firstNonzeroAVX2;
+    }
+    else if (__builtin_cpu_supports("sse2")) {
+        firstNonzero = firstNonzeroSSE2;
     }
+#endif
+}
 
-    dCur = (struct GGGGC_Descriptor *)child;
-    /* deal with other refs */
-    if (dCur->pointers[0] & 1) {
-        maxWord = (dCur->size - 1)/GGGGC_BITS_PER_WORD;
-        for (pWord = 0; pWord <= maxWord; pWord++) {
-            pCur = dCur->pointers[pWord];
-            maxBit = (pWord == maxWord)?((dCur->size - 1)%GGGGC_BITS_PER_WORD):(GGGGC_BITS_PER_WORD);
-            for (pBit = 0; pBit <= maxBit; pBit++) {
-                if ((pCur & 1) && (pBit != 0 || pWord != 0)) {
-                	child = getCorrectChild(*(ggc_size_t **)(obj + pWord*GGGGC_BITS_PER_WORD + pBit));
-                	if (child != NULL && !isMarked(child)) {
-		        		mark(child);
-		        		pushWorklistFull(child);
-		        	}
-		        	if (child != NULL && GEN_OF(obj) == GEN_OF_OLD && GEN_OF(child) != GEN_OF_OLD) {
-		        		setRememberSet((ggc_size_t *)(obj + pWord*GGGGC_BITS_PER_WORD + pBit));
-		        	}
-                }
-                pCur >>= 1;
-            }
+/* the offset of the first marked word in an old pool at or after i, or end
+ * if there's none before end */
+static ggc_size_t nextMarked(struct GGGGC_PoolOld *tempPool, ggc_size_t i, ggc_size_t end)
+{
+    ggc_size_t w = i/GGGGC_BITS_PER_WORD, wEnd, bits;
+
+    bits = tempPool->markBitmap[w] & ((ggc_size_t)-1 << (i%GGGGC_BITS_PER_WORD));
+    if (!bits) {
+        /* the words that cover up to end */
+        wEnd = (end + GGGGC_BITS_PER_WORD - 1)/GGGGC_BITS_PER_WORD;
+        w = firstNonzero(tempPool->markBitmap, w + 1, wEnd);
+        if (w >= wEnd) {
+            return end;
         }
+        bits = tempPool->markBitmap[w];
     }
+    i = w*GGGGC_BITS_PER_WORD + lowestBit(bits);
+    return (i < end) ? i : end;
 }
 
-void ggggc_collectFull()
-{
-	ggc_size_t *obj, *ptr;
-	struct GGGGC_PoolOld *tempPool;
-	struct GGGGC_Freeobj *endFo, *newFo;
-	int poolsNeed;
+#ifdef GGGGC_LAZY_SWEEP
+static void finishSweep(void);
+#endif
 
-	inCollectFull = 1;
-	lCtOld = 0;
-	clearRememberSet();
+#ifdef GGGGC_CONCURRENT_MARK
+/* words promoted since the old gen was last swept, which decides when the
+ * next concurrent mark starts */
+static ggc_size_t oldGrowth;
 
-	/* mark */
-	initializeWorklistFull();
-	while (obj = popWorklistFull()) {
-		scanFull(obj);
-	}
-	freeWorklistFull();
+static void abortMark(void);
+static void greyYoung(void);
+static void startMarkIfDue(void);
+#endif
+
+/* how many young collections a young object has survived */
+static ggc_size_t ageOf(ggc_size_t *obj)
+{
+#if GGGGC_TENURING_THRESHOLD > 2
+    struct GGGGC_Pool *tempPool;
+#endif
 
-	/* sweep old gen and build freelist */
-	if (!freelist) {
-    	freelist = (struct GGGGC_Freeobj *)malloc(sizeof(struct GGGGC_Freeobj));
-    	freelist->next = NULL;
+    if (GEN_OF(obj) == GEN_OF_B0) {
+        return 0;
     }
-    endFo = freelist;
-    for (tempPool = oldHead; tempPool != oldCur->next; tempPool = tempPool->next) {
-        ptr = tempPool->start;
-        while (ptr < tempPool->free) {
-            if (isMarked(ptr)) {
-                unmark(ptr);
-                lCtOld += ((struct GGGGC_Header *)ptr)->descriptor__ptr->size;
-                ptr += ((struct GGGGC_Header *)ptr)->descriptor__ptr->size;
-            }
-            else {
-                newFo = (struct GGGGC_Freeobj *)ptr;
-                newFo->next = NULL;
+#if GGGGC_TENURING_THRESHOLD > 2
+    tempPool = GGGGC_POOL_OF(obj);
+    return tempPool->ages[(obj - tempPool->start)/2];
+#else
+    return 1;
+#endif
+}
 
-                while (!isMarked(ptr) && ptr < tempPool->free) {
-                    if (isMarkedFo((struct GGGGC_Freeobj *)ptr)) {
-                        unmarkFo((struct GGGGC_Freeobj *)ptr);
-                        newFo->selfend = ((struct GGGGC_Freeobj *)ptr)->selfend;
-                        ptr = newFo->selfend + 1;
-                    }
-                    else {
-                        ptr += ((struct GGGGC_Header *)ptr)->descriptor__ptr->size;
-                        newFo->selfend = ptr - 1;
-                    }
-                }
-                markFo(newFo);
-                endFo->next = newFo;
-                endFo = newFo;
-            }
+/* record the age of an object just copied into B1 tospace */
+static void setAge(ggc_size_t *obj, ggc_size_t age)
+{
+#if GGGGC_TENURING_THRESHOLD > 2
+    struct GGGGC_Pool *tempPool = GGGGC_POOL_OF(obj);
+    tempPool->ages[(obj - tempPool->start)/2] = age;
+#else
+    (void) obj;
+    (void) age;
+#endif
+}
+
+#ifdef GGGGC_ADAPTIVE_TENURING
+/* words kept in B1 by this young collection, by their new age */
+static ggc_size_t survived[GGGGC_TENURING_THRESHOLD];
+
+/* HotSpot's rule: if the survivors kept in B1 fill more than
+ * GGGGC_TARGET_SURVIVOR_PERCENT of its tospace, the next young collection
+ * promotes from the youngest age at which they got there */
+static void adjustTenuring()
+{
+    ggc_size_t age, total = 0, desired;
+
+    desired = pCtB1/2 * (GGGGC_WORDS_PER_POOL/100) * GGGGC_TARGET_SURVIVOR_PERCENT;
+    tenuringThreshold = GGGGC_TENURING_THRESHOLD;
+    for (age = 1; age < GGGGC_TENURING_THRESHOLD; age++) {
+        total += survived[age];
+        survived[age] = 0;
+        if (total > desired && tenuringThreshold == GGGGC_TENURING_THRESHOLD) {
+            tenuringThreshold = age + 1;
         }
     }
-	
-	poolsNeed = (lCtOld * 2)/GGGGC_WORDS_PER_POOL + 1 - pCtOld;
-	ggggc_expandOld(poolsNeed);
+}
+#endif
 
-    if (inCollect) {
-        /* if ggggc_collectFull() is called by ggggc_collect(), discard the old young worklist */
-        freeWorklist();
+#ifndef GGGGC_PARALLEL_COLLECT
+/* copy an object out of B0 or B1 fromspace and leave a forwarding address,
+ * returns NULL if it needed promotion and the old gen is full */
+static ggc_size_t *copyObject(ggc_size_t *fromRef)
+{
+    ggc_size_t *toRef, age;
+    struct GGGGC_Descriptor *dCur;
+
+    unmark(fromRef);
+    dCur = ((struct GGGGC_Header *)fromRef)->descriptor__ptr;
+    age = ageOf(fromRef) + 1;
+    if (age < tenuringThreshold) {
+        toRef = ggggc_mallocB1(dCur);
+        setAge(toRef, age);
+#ifdef GGGGC_ADAPTIVE_TENURING
+        survived[age] += dCur->size;
+#endif
     }
     else {
-        /* if ggggc_collectFull() is called independently, still need a re-try young collect */
-        ggggc_collect();
+        toRef = ggggc_mallocOld(dCur);
+        if (toRef == NULL) {
+            return NULL;
+        }
+        lCtB1 += dCur->size;
+#ifdef GGGGC_CONCURRENT_MARK
+        /* promoted past the snapshot, so it's live */
+        if (ggggc_marking) {
+            bitmapMark(toRef);
+        }
+#endif
     }
+    memcpy(toRef, fromRef, (dCur->size)*sizeof(ggc_size_t));
+    setForwardingAddress(fromRef, toRef);
+    return toRef;
 }
+#endif
 
-/* ggggc_collectFull() */
-/*******************************************************************************************/
-/* ggggc_yield() */
+static void pushIfNeedWorklist(ggc_size_t **loc, char needToRemember)
+{
+    /* save some unnecessary pushes here */
+	if (*loc != NULL && (GEN_OF(*loc) != GEN_OF_OLD)) {
+        if (GEN_OF(*loc) == GEN_OF_B1TO && !isMarked(*loc)) {
+            /* already copied, but a full collection in a re-try may have
+             * updated the slot of an object that's only now promoted */
+            if (needToRemember) {
+                setRememberSet((ggc_size_t *)loc);
+            }
+            return;
+        }
+		if (forwarded(*loc)) {
+			ggc_size_t *toRef = forwardingAddress(*loc);
+			*loc = toRef;
+			if (needToRemember && (GEN_OF(toRef) != GEN_OF_OLD)) {
+				setRememberSet((ggc_size_t *)loc);
+			}
+		}
+		else {
+#ifdef GGGGC_CHENEY_SCAN
+            /* copy right away, the copies themselves are the queue */
+            if (GEN_OF(*loc) == GEN_OF_B1TO) {
+                /* marked in a re-try young collect, so it's live but unscanned */
+                unmark(*loc);
+                pushWorklist(&worklist, (ggc_size_t)*loc);
+            }
+            else if (!promotionFailed) {
+                ggc_size_t *toRef = copyObject(*loc);
+                if (toRef == NULL) {
+                    promotionFailed = 1;
+                    return;
+                }
+                if (GEN_OF(toRef) == GEN_OF_OLD && oldFromFreelist) {
+                    /* promoted into a hole, which the old gen scan won't reach */
+                    pushWorklist(&worklist, (ggc_size_t)toRef);
+                }
+                *loc = toRef;
+                if (needToRemember && (GEN_OF(toRef) != GEN_OF_OLD)) {
+                    setRememberSet((ggc_size_t *)loc);
+                }
+            }
+#elif defined(GGGGC_PARALLEL_COLLECT)
+            ggggc_dequePush(&curWorker->deque, (ggc_size_t)loc | (needToRemember != 0));
+            curWorker->pushed++;
+#else
+            /* locs are word aligned, so the low bit carries needToRemember */
+            pushWorklist(&worklist, (ggc_size_t)loc | (needToRemember != 0));
+#endif
+		}
+	}
+}
 
-int ggggc_yield()
+static void pushRoot(ggc_size_t **loc)
 {
-    if (freelisthops > 20) {
-		ggggc_collectFull();
+    pushIfNeedWorklist(loc, 0);
+}
+
+#ifdef GGGGC_CARD_TABLE
+/* the first object or free run in an old pool that reaches into a card */
+static ggc_size_t *cardFirstObject(struct GGGGC_PoolOld *tempPool, ggc_size_t card)
+{
+    ggc_size_t *cardStart, *ptr, k;
+
+    cardStart = (ggc_size_t *)tempPool + card*GGGGC_WORDS_PER_CARD;
+    if (cardStart <= tempPool->start) {
+        return tempPool->start;
+    }
+    if (tempPool->crossing[card] == 0) {
+        return cardStart;
+    }
+
+    /* walk from the last start noted before the card */
+    k = card;
+    do {
+        k--;
+    } while (tempPool->crossing[k] == GGGGC_CROSSING_NONE);
+    ptr = (ggc_size_t *)tempPool + k*GGGGC_WORDS_PER_CARD + tempPool->crossing[k];
+    while (ptr + walkSize(ptr) <= cardStart) {
+        ptr += walkSize(ptr);
+    }
+    return ptr;
+}
+
+/* push a slot in a dirty card if it points to the young gen, and say so */
+static unsigned char pushCardSlot(ggc_size_t **loc)
+{
+    if (*loc != NULL && (GEN_OF(*loc) != GEN_OF_OLD)) {
+        pushIfNeedWorklist(loc, 0);
+        return 1;
+    }
+    return 0;
+}
+
+/* add refs of young gen in a pool's dirty cards, and clean the cards that
+ * have none */
+static void pushRememberSet(struct GGGGC_PoolOld *tempPool)
+{
+    ggc_size_t w, wEnd, card, i, last, pWord, pCur, *cardStart, *cardEnd, *obj;
+    struct GGGGC_Descriptor *dCur;
+    unsigned char young;
+
+    /* a large object may run past the pool its cards cover */
+    if (tempPool->free - (ggc_size_t *)tempPool > (ptrdiff_t)GGGGC_WORDS_PER_POOL) {
+        wEnd = GGGGC_CARDS_PER_POOL/sizeof(ggc_size_t);
+    }
+    else {
+        wEnd = (GGGGC_CARD_OF(tempPool->free - 1) + sizeof(ggc_size_t))/sizeof(ggc_size_t);
+    }
+    for (w = 0; (w = firstNonzero((const ggc_size_t *)tempPool->cards, w, wEnd)) < wEnd; w++) {
+        for (card = w*sizeof(ggc_size_t); card < (w + 1)*sizeof(ggc_size_t); card++) {
+            if (!tempPool->cards[card]) {
+                continue;
+            }
+            young = 0;
+            cardStart = (ggc_size_t *)tempPool + card*GGGGC_WORDS_PER_CARD;
+            cardEnd = cardStart + GGGGC_WORDS_PER_CARD;
+            if (cardEnd > tempPool->free) {
+                cardEnd = tempPool->free;
+            }
+
+            /* every pointer of every object in the card, and only in the card */
+            for (obj = cardFirstObject(tempPool, card); obj < cardEnd; obj += walkSize(obj)) {
+                if (isMarkedFo((struct GGGGC_Freeobj *)obj)) {
+                    continue;
+                }
+                dCur = (struct GGGGC_Descriptor *)(*obj & ~7);
+                i = (obj < cardStart) ? cardStart - obj : 0;
+                last = (obj + dCur->size < cardEnd) ? dCur->size : (ggc_size_t)(cardEnd - obj);
+                if (i == 0) {
+                    /* the first word is always a pointer */
+                    young |= pushCardSlot((ggc_size_t **)obj);
+                    i = 1;
+                }
+                switch (dCur->shape) {
+                    case GGGGC_SHAPE_NONE:
+                        break;
+
+                    case GGGGC_SHAPE_ARRAY:
+                        for (i = (i < 2) ? 2 : i; i < last; i++) {
+                            young |= pushCardSlot((ggc_size_t **)(obj + i));
+                        }
+                        break;
+
+                    default:
+                        /* just the bits of the bitmap from i to last */
+                        for (pWord = i/GGGGC_BITS_PER_WORD; pWord*GGGGC_BITS_PER_WORD < last; pWord++) {
+                            pCur = dCur->pointers[pWord];
+                            if (pWord == i/GGGGC_BITS_PER_WORD) {
+                                pCur &= (ggc_size_t)-1 << (i%GGGGC_BITS_PER_WORD);
+                            }
+                            if ((pWord + 1)*GGGGC_BITS_PER_WORD > last) {
+                                pCur &= ((ggc_size_t)1 << (last%GGGGC_BITS_PER_WORD)) - 1;
+                            }
+                            for (; pCur; pCur &= pCur - 1) {
+                                young |= pushCardSlot((ggc_size_t **)(obj + pWord*GGGGC_BITS_PER_WORD + lowestBit(pCur)));
+                            }
+                        }
+                }
+            }
+            tempPool->cards[card] = young;
+        }
+    }
+}
+
+#else
+/* the first word of a pool's remember set from i on whose summary bit is
+ * set, or REMEMBERSET_SIZE if there's none */
+static ggc_size_t nextRememberedWord(struct GGGGC_PoolOld *tempPool, ggc_size_t i)
+{
+	ggc_size_t w = i/GGGGC_BITS_PER_WORD, bits;
+
+	if (i >= REMEMBERSET_SIZE) {
+		return REMEMBERSET_SIZE;
+	}
+	bits = tempPool->rememberSummary[w] & ((ggc_size_t)-1 << (i%GGGGC_BITS_PER_WORD));
+	if (!bits) {
+		w = firstNonzero(tempPool->rememberSummary, w + 1, REMEMBERSUMMARY_SIZE);
+		if (w >= REMEMBERSUMMARY_SIZE) {
+			return REMEMBERSET_SIZE;
+		}
+		bits = tempPool->rememberSummary[w];
+	}
+	return w*GGGGC_BITS_PER_WORD + lowestBit(bits);
+}
+
+/* forget some remembered slots of a remember set word, and the word in the
+ * summary if that empties it. With parallel workers, another may remember a
+ * slot in the word meanwhile: it sets the slot's bit before the summary's,
+ * so either it sets the summary bit after it's cleared here, or the
+ * recheck here sees the slot's bit */
+static void unremember(struct GGGGC_PoolOld *tempPool, ggc_size_t i, ggc_size_t mask)
+{
+	ggc_size_t *summary = &tempPool->rememberSummary[i/GGGGC_BITS_PER_WORD];
+	ggc_size_t summaryBit = (ggc_size_t)1 << (i%GGGGC_BITS_PER_WORD);
+
+#ifdef GGGGC_PARALLEL_COLLECT
+	if (!__atomic_and_fetch(&tempPool->rememberSet[i], ~mask, __ATOMIC_SEQ_CST)) {
+		__atomic_fetch_and(summary, ~summaryBit, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&tempPool->rememberSet[i], __ATOMIC_SEQ_CST)) {
+			__atomic_fetch_or(summary, summaryBit, __ATOMIC_SEQ_CST);
+		}
+	}
+#else
+	tempPool->rememberSet[i] &= ~mask;
+	if (!tempPool->rememberSet[i]) {
+		*summary &= ~summaryBit;
+	}
+#endif
+}
+
+/* add refs of young gen in a pool's remember set, jumping from one set bit
+ * to the next */
+static void pushRememberSet(struct GGGGC_PoolOld *tempPool)
+{
+	ggc_size_t i, bits, bit, wrong, **loc;
+
+	for (i = nextRememberedWord(tempPool, 0); i < REMEMBERSET_SIZE; i = nextRememberedWord(tempPool, i + 1)) {
+		bits = tempPool->rememberSet[i];
+		wrong = 0;
+		while (bits) {
+			bit = bits & -bits;
+			loc = (ggc_size_t **)(tempPool->start + i*GGGGC_BITS_PER_WORD + lowestBit(bits));
+			bits &= bits - 1;
+			if (*loc != NULL && (GEN_OF(*loc) != GEN_OF_OLD)) {
+				pushIfNeedWorklist(loc, 0);
+			}
+			else {
+				wrong |= bit;
+			}
+		}
+		/* reset wrongly remembered bits, and the summary of an empty word */
+		if (wrong || !tempPool->rememberSet[i]) {
+			unremember(tempPool, i, wrong);
+		}
+	}
+}
+#endif
+
+#ifndef GGGGC_PARALLEL_COLLECT
+static void initializeWorklist()
+{
+	struct GGGGC_PoolOld *tempPool;
+
+    /* add refs of young gen in remember set */
+    for (tempPool = oldHead; tempPool != oldCur->next; tempPool = tempPool->next) {
+        pushRememberSet(tempPool);
+    }
+    for (tempPool = largeHead; tempPool; tempPool = tempPool->next) {
+        pushRememberSet(tempPool);
+    }
+
+    /* add refs of young gen in roots */
+    forEachRoot(pushRoot);
+}
+#endif
+
+static void scan(ggc_size_t *obj)
+{
+	ggc_size_t pWord, maxWord, pCur, i, ct;
+	ggc_size_t **loc, **end, **slots[GGGGC_BITS_PER_WORD];
+	char needToRemember;
+    struct GGGGC_Descriptor *dCur;
+
+    if (GEN_OF(obj) == GEN_OF_OLD) {
+    	needToRemember = 1;
+    }
+    else {
+    	needToRemember = 0;
+    }
+    
+    dCur = ((struct GGGGC_Header *)obj)->descriptor__ptr;
+    switch (dCur->shape) {
+        case GGGGC_SHAPE_TRACER:
+            pushIfNeedWorklist((ggc_size_t **)obj, needToRemember);
+            ct = dCur->tracer(obj, slots);
+            for (i = 0; i < ct; i++) {
+                pushIfNeedWorklist(slots[i], needToRemember);
+            }
+            break;
+
+        case GGGGC_SHAPE_ARRAY:
+            pushIfNeedWorklist((ggc_size_t **)obj, needToRemember);
+            end = (ggc_size_t **)obj + dCur->size;
+            for (loc = (ggc_size_t **)obj + 2; loc < end; loc++) {
+                pushIfNeedWorklist(loc, needToRemember);
+            }
+            break;
+
+        case GGGGC_SHAPE_NONE:
+            /* even if the object has no refs, still need to process it's first word */
+            pushIfNeedWorklist((ggc_size_t **)obj, needToRemember);
+            break;
+
+        default:
+            maxWord = (dCur->size - 1)/GGGGC_BITS_PER_WORD;
+            for (pWord = 0; pWord <= maxWord; pWord++) {
+                for (pCur = pointerWord(dCur, pWord); pCur; pCur &= pCur - 1) {
+                    pushIfNeedWorklist((ggc_size_t **)(obj + pWord*GGGGC_BITS_PER_WORD + lowestBit(pCur)), needToRemember);
+                }
+            }
+    }
+}
+
+#ifdef GGGGC_PARALLEL_COLLECT
+/* the roots of a parallel young collect, split into tasks for the workers:
+ * each old pool's remember set, then each large object's, then each
+ * thread's pointer stack and the globals. The first rootOldCt are the old
+ * pools, for a parallel sweep */
+static struct GGGGC_PoolOld **rootPools;
+static struct GGGGC_PointerStack **rootStacks;
+static ggc_size_t rootPoolCt, rootOldCt, rootStackCt, rootTaskSize;
+static volatile ggc_size_t nextRootTask;
+
+static void gatherRootTasks()
+{
+    ggc_size_t ct = 1;
+    struct GGGGC_PoolOld *tempPool;
+    struct GGGGC_ThreadInfo *ti;
+
+    for (tempPool = oldHead; tempPool != oldCur->next; tempPool = tempPool->next) ct++;
+    for (tempPool = largeHead; tempPool; tempPool = tempPool->next) ct++;
+    for (ti = ggggc_threads; ti; ti = ti->next) ct++;
+    if (ct > rootTaskSize) {
+        rootPools = (struct GGGGC_PoolOld **)realloc(rootPools, ct*sizeof(struct GGGGC_PoolOld *));
+        rootStacks = (struct GGGGC_PointerStack **)realloc(rootStacks, ct*sizeof(struct GGGGC_PointerStack *));
+        if (rootPools == NULL || rootStacks == NULL) {
+            perror("realloc");
+            abort();
+        }
+        rootTaskSize = ct;
+    }
+
+    rootPoolCt = 0;
+    for (tempPool = oldHead; tempPool != oldCur->next; tempPool = tempPool->next) {
+        rootPools[rootPoolCt++] = tempPool;
+    }
+    rootOldCt = rootPoolCt;
+    for (tempPool = largeHead; tempPool; tempPool = tempPool->next) {
+        rootPools[rootPoolCt++] = tempPool;
+    }
+    rootStackCt = 0;
+    for (ti = ggggc_threads; ti; ti = ti->next) {
+        rootStacks[rootStackCt++] = *ti->pointerStack;
+    }
+    rootStacks[rootStackCt++] = ggggc_pointerStackGlobals;
+    nextRootTask = 0;
+}
+
+static void pushStack(struct GGGGC_PointerStack *psCur)
+{
+    ggc_size_t i;
+
+    for (; psCur; psCur = psCur->next) {
+        for (i = 0; i < psCur->size; i++) {
+            pushRoot((ggc_size_t **)(psCur->pointers[i]));
+        }
+    }
+}
+
+/* give back what's left of a PLAB as a free run, since B1 tospace must stay
+ * walkable. The old gen's can go straight on a freelist */
+static void retirePLAB(ggc_size_t **free, ggc_size_t **end, char old)
+{
+    struct GGGGC_Freeobj *fo;
+
+    if (*free < *end) {
+        fo = (struct GGGGC_Freeobj *)*free;
+        fo->selfend = *end - 1;
+        markFo(fo);
+        if (old) {
+            GGGGC_NOTE_START(fo);
+            ggggc_pushFreeRun(fo);
+        }
+    }
+    *free = *end = NULL;
+}
+
+/* allocate from one of a worker's PLABs, refilling it if need be. NULL if
+ * it's the old gen's and that's full */
+static ggc_size_t *plabAlloc(ggc_size_t **free, ggc_size_t **end, ggc_size_t size, char old)
+{
+    ggc_size_t *ret, plabWords;
+
+    if ((ggc_size_t)(*end - *free) < size) {
+        ggc_mutex_lock_raw(&ggggc_plabLock);
+        retirePLAB(free, end, old);
+        if (old) {
+            ret = (ggc_size_t *)ggggc_mallocOldPLAB(size, &plabWords);
+        }
+        else {
+            ret = (ggc_size_t *)ggggc_mallocB1PLAB(size, &plabWords);
+        }
+        ggc_mutex_unlock(&ggggc_plabLock);
+        if (ret == NULL) {
+            return NULL;
+        }
+        *free = ret;
+        *end = ret + plabWords;
+    }
+
+    ret = *free;
+    *free += size;
+#ifdef GGGGC_CARD_TABLE
+    if (old) {
+        GGGGC_NOTE_START(ret);
+    }
+#endif
+    return ret;
+}
+
+/* copy an object out of B0 or B1 fromspace for a worker, installing the
+ * forwarding address with a CAS since another worker may be copying it too.
+ * Returns whichever copy won, or NULL if it needed promotion and the old gen
+ * is full */
+static ggc_size_t *copyParallel(struct GGGGC_Worker *worker, ggc_size_t *fromRef)
+{
+    ggc_size_t header, size, *toRef, age;
+    char old;
+
+    header = __atomic_load_n(fromRef, __ATOMIC_ACQUIRE);
+    if (header & 4) {
+        return (ggc_size_t *)(header & ~7);
+    }
+
+    size = ((struct GGGGC_Descriptor *)(header & ~7))->size;
+    age = ageOf(fromRef) + 1;
+    old = (age >= tenuringThreshold);
+    if (old) {
+        toRef = plabAlloc(&worker->oldFree, &worker->oldEnd, size, 1);
+    }
+    else {
+        toRef = plabAlloc(&worker->b1Free, &worker->b1End, size, 0);
+    }
+    if (toRef == NULL) {
+        return NULL;
+    }
+    if (!old) {
+        setAge(toRef, age);
+    }
+
+    /* the copy isn't marked, even in a re-try young collect */
+    toRef[0] = header & ~(ggc_size_t)1;
+    memcpy(toRef + 1, fromRef + 1, (size - 1)*sizeof(ggc_size_t));
+    if (!__atomic_compare_exchange_n(fromRef, &header, (ggc_size_t)toRef | 4, 0,
+                                     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)) {
+        /* another worker won, and ours was the last thing in its PLAB */
+        if (old) {
+            worker->oldFree = toRef;
+        }
+        else {
+            worker->b1Free = toRef;
+        }
+        return (ggc_size_t *)(header & ~7);
+    }
+
+    if (old) {
+        worker->promoted += size;
+#ifdef GGGGC_CONCURRENT_MARK
+        if (ggggc_marking) {
+            bitmapMark(toRef);
+        }
+#endif
+    }
+#ifdef GGGGC_ADAPTIVE_TENURING
+    else {
+        worker->survived[age] += size;
+    }
+#endif
+    scan(toRef);
+    return toRef;
+}
+
+/* a worker's share of a young collection */
+static void youngWorker(struct GGGGC_Worker *worker)
+{
+    ggc_size_t task, entry, header, **loc, *fromRef, *toRef;
+
+    curWorker = worker;
+
+    /* claim root tasks until there are none left */
+    while ((task = __atomic_fetch_add(&nextRootTask, 1, __ATOMIC_RELAXED)) < rootPoolCt + rootStackCt) {
+        if (task < rootPoolCt) {
+            pushRememberSet(rootPools[task]);
+        }
+        else {
+            pushStack(rootStacks[task - rootPoolCt]);
+        }
+    }
+#ifdef GGGGC_CARD_TABLE
+    /* a card is walked and cleaned whole, so no worker may promote into it
+     * or dirty it until they're all walked */
+    ggggc_workersSync();
+#endif
+
+    /* then copy, stealing work once our own runs out */
+    while (!promotionFailed) {
+        entry = ggggc_dequePop(&worker->deque);
+        if (!entry && !(entry = ggggc_findWork(worker))) {
+            break;
+        }
+        loc = (ggc_size_t **)(entry & ~(ggc_size_t)1);
+        fromRef = *loc;
+        if (GEN_OF(fromRef) == GEN_OF_B1TO) {
+            /* unscanned in a re-try young collect, the worker that unmarks it scans it */
+            header = __atomic_load_n(fromRef, __ATOMIC_ACQUIRE);
+            if ((header & 1) &&
+                __atomic_compare_exchange_n(fromRef, &header, header & ~(ggc_size_t)1, 0,
+                                            __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                scan(fromRef);
+            }
+        }
+        else {
+            toRef = copyParallel(worker, fromRef);
+            if (toRef == NULL) {
+                /* everyone stops for a full collection */
+                promotionFailed = 1;
+                ggggc_workersAbort = 1;
+                break;
+            }
+            *loc = toRef;
+            if ((entry & 1) && (GEN_OF(toRef) != GEN_OF_OLD)) {
+                setRememberSet((ggc_size_t *)loc);
+            }
+        }
+    }
+
+    curWorker = NULL;
+}
+#endif
+
+static void collectFull(void);
+
+/* when the current full collection or remark started, and how long those
+ * within the current young collection took, for the sizing policy */
+static ggc_size_t fullStart, fullInYoungNs;
+
+#ifdef GGGGC_COMPACT_OLD
+/* each object of the old gen, in address order, while it's being compacted:
+ * its descriptor, which its header can't hold while that holds where it's
+ * going, and its size, since its descriptor may move before it does */
+struct CompactEntry {
+    struct GGGGC_Descriptor *descriptor;
+    ggc_size_t size;
+};
+static struct CompactEntry *compactEntries;
+static ggc_size_t compactEntriesSize;
+
+/* set by a sweep that left the old gen fragmented */
+static char compactDue;
+
+/* after a sweep, the old gen is due for compaction if more than
+ * GGGGC_COMPACT_PERCENT of its pools' used space is free runs, and that's at
+ * least a pool's worth */
+static void checkFragmentation()
+{
+    struct GGGGC_PoolOld *tempPool;
+    ggc_size_t used = 0, freeWords;
+
+    for (tempPool = oldHead; tempPool != oldCur->next; tempPool = tempPool->next) {
+        used += tempPool->free - tempPool->start;
+    }
+    freeWords = (used > lCtOld) ? used - lCtOld : 0;
+    if (freeWords >= GGGGC_WORDS_PER_POOL && freeWords*100 > used*GGGGC_COMPACT_PERCENT) {
+        compactDue = 1;
+    }
+}
+
+/* point a slot to where what it points to is going, and remember it as toLoc,
+ * where it's going, if that's to the young gen */
+static void compactSlot(ggc_size_t **loc, ggc_size_t *toLoc)
+{
+    ggc_size_t *child = getCorrectChild(*loc);
+
+    if (child != *loc) {
+        *loc = child;
+    }
+    if (child != NULL && GEN_OF(toLoc) == GEN_OF_OLD && GEN_OF(child) != GEN_OF_OLD) {
+        setRememberSet(toLoc);
+    }
+}
+
+/* point an object's slots, other than its header, to where what they point
+ * to is going, and remember the ones that point to the young gen as slots of
+ * the object at to, where it's going */
+static void compactSlots(ggc_size_t *obj, struct GGGGC_Descriptor *dCur, ggc_size_t *to)
+{
+	ggc_size_t pWord, pBit, maxWord, pCur, i, ct;
+	ggc_size_t **loc, **end, **slots[GGGGC_BITS_PER_WORD];
+
+    switch (dCur->shape) {
+        case GGGGC_SHAPE_TRACER:
+            ct = dCur->tracer(obj, slots);
+            for (i = 0; i < ct; i++) {
+                compactSlot(slots[i], to + ((ggc_size_t *)slots[i] - obj));
+            }
+            break;
+
+        case GGGGC_SHAPE_ARRAY:
+            end = (ggc_size_t **)obj + dCur->size;
+            for (loc = (ggc_size_t **)obj + 2; loc < end; loc++) {
+                compactSlot(loc, to + ((ggc_size_t *)loc - obj));
+            }
+            break;
+
+        case GGGGC_SHAPE_NONE:
+            break;
+
+        default:
+            /* the header's been dealt with */
+            maxWord = (dCur->size - 1)/GGGGC_BITS_PER_WORD;
+            for (pWord = 0; pWord <= maxWord; pWord++) {
+                pCur = pointerWord(dCur, pWord) & (pWord ? (ggc_size_t)-1 : ~(ggc_size_t)1);
+                for (; pCur; pCur &= pCur - 1) {
+                    pBit = lowestBit(pCur);
+                    compactSlot((ggc_size_t **)(obj + pWord*GGGGC_BITS_PER_WORD + pBit),
+                                to + pWord*GGGGC_BITS_PER_WORD + pBit);
+                }
+            }
+    }
+}
+
+static void compactRoot(ggc_size_t **loc)
+{
+    ggc_size_t *child = getCorrectChild(*loc);
+
+    if (child != *loc) {
+        *loc = child;
+    }
+}
+
+/* point the objects of some young pools to where the old gen's are going */
+static void compactYoung(struct GGGGC_Pool *head, struct GGGGC_Pool *cur)
+{
+    ggc_size_t *ptr, size;
+    struct GGGGC_Pool *tempPool;
+    struct GGGGC_Descriptor *dCur;
+
+    for (tempPool = head; tempPool != cur->next; tempPool = tempPool->next) {
+        ptr = tempPool->start;
+        while (ptr < tempPool->free) {
+            if (isMarkedFo((struct GGGGC_Freeobj *)ptr)) {
+                ptr += getFoSize((struct GGGGC_Freeobj *)ptr);
+                continue;
+            }
+            /* the descriptor is read where it is now, before the header is
+             * pointed to where it's going */
+            dCur = (struct GGGGC_Descriptor *)(*ptr & ~7);
+            size = dCur->size;
+            compactSlots(ptr, dCur, ptr);
+            *ptr = (ggc_size_t)getCorrectChild((ggc_size_t *)dCur) | (*ptr & 7);
+            ptr += size;
+        }
+    }
+}
+
+/* slide every object of the old gen down to the start of its pools, in
+ * order, and give back the pools that empties, with the world stopped and
+ * the young gen just collected. Like a Lisp-2 collector, it's three walks:
+ * one to decide where everything goes, putting that in its header, one to
+ * point everything there, and one to move it. What's in the old gen after
+ * a sweep but isn't a free run is taken to be live, as a young collect takes
+ * everything remembered to be */
+static void compactOld()
+{
+    struct GGGGC_PoolOld *tempPool, *lastPool, *dPool;
+    struct GGGGC_Descriptor *dCur;
+    struct CompactEntry *entry;
+    ggc_size_t *ptr, *end, *to, *dFree, size, i, ct, inUse, start;
+
+    start = ggggc_nsTime();
+    compactDue = 0;
+#ifdef GGGGC_LAZY_SWEEP
+    finishSweep();
+#endif
+#ifdef GGGGC_CONCURRENT_MARK
+    /* the marks would be in the wrong places */
+    abortMark();
+#endif
+
+    /* where everything goes */
+    lastPool = oldCur;
+    dPool = oldHead;
+    dFree = dPool->start;
+    ct = 0;
+    inUse = 0;
+    for (tempPool = oldHead; tempPool != lastPool->next; tempPool = tempPool->next) {
+        inUse++;
+#ifdef GGGGC_CARD_TABLE
+        memset(tempPool->crossing, GGGGC_CROSSING_NONE, GGGGC_CARDS_PER_POOL);
+#endif
+        ptr = tempPool->start;
+        while (ptr < tempPool->free) {
+            if (isMarkedFo((struct GGGGC_Freeobj *)ptr)) {
+                ptr += getFoSize((struct GGGGC_Freeobj *)ptr);
+                continue;
+            }
+            dCur = (struct GGGGC_Descriptor *)(*ptr & ~7);
+            size = dCur->size;
+            if (dFree + size > dPool->end) {
+                /* it can't be past tempPool, since it fit there */
+                dPool = dPool->next;
+                dFree = dPool->start;
+            }
+            if (ct == compactEntriesSize) {
+                compactEntriesSize = compactEntriesSize ? compactEntriesSize*2 : 1024;
+                compactEntries = (struct CompactEntry *)realloc(compactEntries, compactEntriesSize*sizeof(struct CompactEntry));
+                if (compactEntries == NULL) {
+                    perror("realloc");
+                    abort();
+                }
+            }
+            compactEntries[ct].descriptor = dCur;
+            compactEntries[ct].size = size;
+            ct++;
+            setForwardingAddress(ptr, dFree);
+            dFree += size;
+            ptr += size;
+        }
+    }
+
+    /* point everything to where it's going, remembering afresh */
+    clearRememberSet();
+    forEachRoot(compactRoot);
+    compactYoung(b0Head, b0Cur);
+    compactYoung(b1ToHead, b1ToCur);
+    for (tempPool = largeHead; tempPool; tempPool = tempPool->next) {
+        ptr = tempPool->start;
+        dCur = (struct GGGGC_Descriptor *)(*ptr & ~7);
+        compactSlots(ptr, dCur, ptr);
+        *ptr = (ggc_size_t)getCorrectChild((ggc_size_t *)dCur);
+        if (GEN_OF(*ptr) != GEN_OF_OLD) {
+            setRememberSet(ptr);
+        }
+    }
+    entry = compactEntries;
+    for (tempPool = oldHead; tempPool != lastPool->next; tempPool = tempPool->next) {
+        ptr = tempPool->start;
+        while (ptr < tempPool->free) {
+            if (isMarkedFo((struct GGGGC_Freeobj *)ptr)) {
+                ptr += getFoSize((struct GGGGC_Freeobj *)ptr);
+                continue;
+            }
+            to = forwardingAddress(ptr);
+            compactSlots(ptr, entry->descriptor, to);
+            entry->descriptor = (struct GGGGC_Descriptor *)getCorrectChild((ggc_size_t *)entry->descriptor);
+            if (GEN_OF(entry->descriptor) != GEN_OF_OLD) {
+                setRememberSet(to);
+            }
+            ptr += entry->size;
+            entry++;
+        }
+    }
+
+    /* and move it. Nothing goes past where it was, so nothing's
+     * overwritten before it's moved */
+    entry = compactEntries;
+    dPool = oldHead;
+    dFree = dPool->start;
+    lCtOld = 0;
+    for (tempPool = oldHead; tempPool != lastPool->next; tempPool = tempPool->next) {
+        ptr = tempPool->start;
+        end = tempPool->free;
+        while (ptr < end) {
+            if (isMarkedFo((struct GGGGC_Freeobj *)ptr)) {
+                ptr += getFoSize((struct GGGGC_Freeobj *)ptr);
+                continue;
+            }
+            to = forwardingAddress(ptr);
+            if (GGGGC_POOLOLD_OF(to) != dPool) {
+                dPool->free = dFree;
+                dPool = dPool->next;
+            }
+            memmove(to, ptr, entry->size*sizeof(ggc_size_t));
+            *to = (ggc_size_t)entry->descriptor;
+            GGGGC_NOTE_START(to);
+#ifdef GGGGC_EVACUATE_OLD
+            if (to == dPool->start) {
+                dPool->survivors = 0;
+            }
+            dPool->survivors += entry->size;
+#endif
+            dFree = to + entry->size;
+            lCtOld += entry->size;
+            ptr += entry->size;
+            entry++;
+        }
+    }
+    dPool->free = dFree;
+    for (tempPool = dPool->next; tempPool != lastPool->next; tempPool = tempPool->next) {
+        tempPool->free = tempPool->start;
+#ifdef GGGGC_EVACUATE_OLD
+        tempPool->survivors = 0;
+#endif
+    }
+    oldCur = dPool;
+    ggggc_clearFreelists();
+    freelisthops = 0;
+
+    /* the pools it emptied go back, but not the old gen's other headroom */
+    for (tempPool = oldHead, i = 1; tempPool != oldCur; tempPool = tempPool->next) i++;
+    ggggc_resizeOld(pCtOld - (inUse - i));
+    ggggc_trimFreePools();
+
+    start = ggggc_nsTime() - start;
+    ggggc_collectionStats.compactions++;
+    ggggc_collectionStats.compactNs += start;
+    fullInYoungNs += start;
+}
+#endif
+
+/* a young collection, with the world stopped */
+static void collectYoung()
+{
+#ifdef GGGGC_PARALLEL_COLLECT
+    ggc_size_t i;
+#ifdef GGGGC_ADAPTIVE_TENURING
+    ggc_size_t age;
+#endif
+#elif defined(GGGGC_CHENEY_SCAN)
+    ggc_size_t entry;
+    struct GGGGC_Pool *b1ScanPool;
+    struct GGGGC_PoolOld *oldScanPool;
+    ggc_size_t *b1Scan, *oldScan;
+#else
+    ggc_size_t entry;
+	ggc_size_t **loc, *fromRef, *toRef;
+#endif
+    ggc_size_t start;
+
+    start = ggggc_nsTime();
+    fullInYoungNs = 0;
+
+    /* B0 must be walkable */
+    ggggc_retireTLABs();
+
+#ifdef GGGGC_CONCURRENT_MARK
+    /* young objects that die now may have been all that led to some of the
+     * snapshot */
+    if (ggggc_marking) {
+        greyYoung();
+    }
+#endif
+
+    inCollect = 1;
+    lCtB1 = 0;
+    worklist.pushCt = 0;
+    swapB1Pools();
+
+    /* re-try young collect start here */
+    retry:
+
+#if defined(GGGGC_PARALLEL_COLLECT)
+    gatherRootTasks();
+    promotionFailed = 0;
+    ggggc_runWorkers(youngWorker);
+
+    for (i = 0; i < ggggc_workerCt; i++) {
+        retirePLAB(&ggggc_workers[i].b1Free, &ggggc_workers[i].b1End, 0);
+        retirePLAB(&ggggc_workers[i].oldFree, &ggggc_workers[i].oldEnd, 1);
+        lCtB1 += ggggc_workers[i].promoted;
+        ggggc_workers[i].promoted = 0;
+        worklist.pushCt += ggggc_workers[i].pushed;
+        ggggc_workers[i].pushed = 0;
+#ifdef GGGGC_ADAPTIVE_TENURING
+        for (age = 1; age < GGGGC_TENURING_THRESHOLD; age++) {
+            survived[age] += ggggc_workers[i].survived[age];
+            ggggc_workers[i].survived[age] = 0;
+        }
+#endif
+    }
+
+    if (promotionFailed) {
+        collectFull();
+        goto retry;
+    }
+
+#elif defined(GGGGC_CHENEY_SCAN)
+    /* everything copied from here on is scanned in place: B1 tospace and
+     * the bump region of the old gen from their current free pointers, and
+     * anything else from the worklist */
+    b1ScanPool = b1ToCur;
+    b1Scan = b1ToCur->free;
+    oldScanPool = oldCur;
+    oldScan = oldCur->free;
+    promotionFailed = 0;
+
+	initializeWorklist();
+    while (!promotionFailed) {
+        if (b1Scan < b1ScanPool->free) {
+            scan(b1Scan);
+            b1Scan += ((struct GGGGC_Header *)b1Scan)->descriptor__ptr->size;
+        }
+        else if (b1ScanPool != b1ToCur) {
+            b1ScanPool = b1ScanPool->next;
+            b1Scan = b1ScanPool->start;
+        }
+        else if (oldScan < oldScanPool->free) {
+            scan(oldScan);
+            oldScan += ((struct GGGGC_Header *)oldScan)->descriptor__ptr->size;
+        }
+        else if (oldScanPool != oldCur) {
+            oldScanPool = oldScanPool->next;
+            oldScan = oldScanPool->start;
+        }
+        else if ((entry = popWorklist(&worklist))) {
+            scan((ggc_size_t *)entry);
+        }
+        else {
+            break;
+        }
+    }
+
+    if (promotionFailed) {
+        collectFull();
+        goto retry;
+    }
+
+#else
+	initializeWorklist();
+	while ((entry = popWorklist(&worklist))) {
+		loc = (ggc_size_t **)(entry & ~(ggc_size_t)1);
+		fromRef = *loc;
+        /* need to do unmark job for re-try young collect */
+        if (GEN_OF(fromRef) == GEN_OF_B1TO) {
+            if (isMarked(fromRef)) {
+                /* obj is not scanned */
+                unmark(fromRef);
+                scan(fromRef);
+            }
+        }
+        else {
+            if (forwarded(fromRef)) {
+                toRef = forwardingAddress(fromRef);
+            }
+            else {
+                toRef = copyObject(fromRef);
+                if (toRef == NULL) {
+                    collectFull();
+                    goto retry;
+                }
+                scan(toRef);
+            }
+            /* update loc */
+            *loc = toRef;
+            if ((entry & 1) && (GEN_OF(toRef) != GEN_OF_OLD)) {
+                setRememberSet((ggc_size_t *)loc);
+            }
+        }
+	}
+
+#endif
+#ifdef GGGGC_ADAPTIVE_TENURING
+    adjustTenuring();
+#endif
+    resetPools();
+#ifdef GGGGC_COMPACT_OLD
+    if (compactDue) {
+        compactOld();
+    }
+#endif
+    ggggc_collectionStats.pushed += worklist.pushCt;
+    ggggc_sizeAfterYoung(ggggc_nsTime() - start - fullInYoungNs);
+    inCollectFull = 0;
+    inCollect = 0;
+
+#ifdef GGGGC_CONCURRENT_MARK
+    oldGrowth += lCtB1;
+    startMarkIfDue();
+#endif
+}
+
+/* a young collection, by a thread holding ggggc_allocLock */
+void ggggc_collectLocked()
+{
+    ggggc_stopWorld();
+    collectYoung();
+    ggggc_startWorld();
+}
+
+void ggggc_collect()
+{
+    /* the caller's roots must be seen */
+    ggggc_registerThread();
+
+    ggc_mutex_lock(&ggggc_allocLock);
+    ggggc_collectLocked();
+    ggc_mutex_unlock(&ggggc_allocLock);
+}
+
+/* ggggc_collect() */
+/*******************************************************************************************/
+/* ggggc_collectFull() */
+
+#ifdef GGGGC_PARALLEL_COLLECT
+/* the workers' deques grow as they need, so they never overflow */
+static void pushWorklistFull(ggc_size_t *obj)
+{
+    ggggc_dequePush(&curWorker->deque, (ggc_size_t)obj);
+}
+
+#else
+/* set when the mark stack couldn't grow, so some marked objects were never
+ * pushed and the heap must be rescanned for them */
+static char markStackOverflow;
+
+static void pushWorklistFull(ggc_size_t *obj)
+{
+    if (!tryPushWorklist(&worklistFull, (ggc_size_t)obj)) {
+        /* obj stays marked, so a rescan will find it */
+        markStackOverflow = 1;
+    }
+}
+
+static ggc_size_t *popWorklistFull()
+{
+    return (ggc_size_t *)popWorklist(&worklistFull);
+}
+
+#endif
+
+/* mark an object, returns 1 if it wasn't marked already. With parallel
+ * marking, only one worker can be the one to mark it */
+static int tryMark(ggc_size_t *obj)
+{
+    if (GEN_OF(obj) == GEN_OF_OLD) {
+        return !isBitmapMarked(obj) && bitmapMark(obj);
+    }
+    if (isMarked(obj)) {
+        return 0;
+    }
+#ifdef GGGGC_PARALLEL_COLLECT
+    return !(__atomic_fetch_or(obj, 1, __ATOMIC_RELAXED) & 1);
+#else
+    mark(obj);
+    return 1;
+#endif
+}
+
+#ifdef GGGGC_EVACUATE_OLD
+/* set while a full collection is evacuating some old pools */
+static char evacuating;
+
+/* pick the old pools to evacuate in this full collection: those less than
+ * GGGGC_EVACUATE_PERCENT full. oldCur is never evacuated, since the copies
+ * go there */
+static void chooseEvacuation()
+{
+    struct GGGGC_PoolOld *tempPool;
+
+    for (tempPool = oldHead; tempPool != oldCur; tempPool = tempPool->next) {
+        if (tempPool->survivors*100 < (ggc_size_t)(tempPool->end - tempPool->start)*GGGGC_EVACUATE_PERCENT) {
+            tempPool->evacuate = 1;
+            evacuating = 1;
+        }
+    }
+}
+
+/* and stop, once they're marked */
+static void endEvacuation()
+{
+    struct GGGGC_PoolOld *tempPool;
+
+    if (!evacuating) {
+        return;
+    }
+    for (tempPool = oldHead; tempPool != oldCur->next; tempPool = tempPool->next) {
+        tempPool->evacuate = 0;
+    }
+    evacuating = 0;
+}
+
+/* space for an evacuated object, bumped from the old gen's unused space.
+ * It grows if there's none left, since the pools evacuated are given back,
+ * and each has at most GGGGC_EVACUATE_PERCENT of a pool to copy */
+static ggc_size_t *evacuateAlloc(ggc_size_t size)
+{
+    ggc_size_t *ret;
+
+    while ((ggc_size_t)(oldCur->end - oldCur->free) < size) {
+        if (!oldCur->next) {
+            ggggc_expandOld(1);
+        }
+        oldCur = oldCur->next;
+    }
+    ret = oldCur->free;
+    oldCur->free += size;
+    oldCur->survivors += size;
+    GGGGC_NOTE_START(ret);
+    return ret;
+}
+
+/* mark an object in a pool being evacuated by copying it out. Returns where
+ * it is now, and sets *marked if this was the marking. With parallel
+ * marking, a worker claims it by setting its header's low bit, which old
+ * objects don't otherwise use, and the others wait for it to be forwarded */
+static ggc_size_t *evacuate(ggc_size_t *obj, int *marked)
+{
+    ggc_size_t header, size, *to;
+
+#ifdef GGGGC_PARALLEL_COLLECT
+    while (1) {
+        header = __atomic_load_n(obj, __ATOMIC_ACQUIRE);
+        if (header & 4) {
+            return (ggc_size_t *)(header & ~7);
+        }
+        if (!(header & 1) &&
+            __atomic_compare_exchange_n(obj, &header, header | 1, 0, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            break;
+        }
+    }
+    size = ((struct GGGGC_Descriptor *)header)->size;
+    ggc_mutex_lock_raw(&ggggc_plabLock);
+    to = evacuateAlloc(size);
+    ggc_mutex_unlock(&ggggc_plabLock);
+    memcpy(to + 1, obj + 1, (size - 1)*sizeof(ggc_size_t));
+    *to = header;
+    bitmapMark(to);
+    __atomic_store_n(obj, (ggc_size_t)to | 4, __ATOMIC_RELEASE);
+
+#else
+    if (forwarded(obj)) {
+        return forwardingAddress(obj);
+    }
+    header = *obj;
+    size = ((struct GGGGC_Descriptor *)header)->size;
+    to = evacuateAlloc(size);
+    memcpy(to, obj, size*sizeof(ggc_size_t));
+    bitmapMark(to);
+    setForwardingAddress(obj, to);
+#endif
+
+    *marked = 1;
+    return to;
+}
+#endif
+
+/* mark a child, pushing it if this was the marking, and return where it is
+ * now, which is elsewhere if it was evacuated */
+static ggc_size_t *markChild(ggc_size_t *child)
+{
+#ifdef GGGGC_EVACUATE_OLD
+    int marked = 0;
+
+    if (evacuating && GEN_OF(child) == GEN_OF_OLD && GGGGC_POOLOLD_OF(child)->evacuate) {
+        child = evacuate(child, &marked);
+        if (marked) {
+            pushWorklistFull(child);
+        }
+        return child;
+    }
+#endif
+    if (tryMark(child)) {
+        pushWorklistFull(child);
+    }
+    return child;
+}
+
+static void markRoot(ggc_size_t **loc)
+{
+    ggc_size_t *obj = getCorrectChild(*loc), *moved;
+
+    if (obj != NULL) {
+        moved = markChild(obj);
+        if (moved != obj) {
+            *loc = moved;
+        }
+    }
+}
+
+#ifndef GGGGC_PARALLEL_COLLECT
+static void initializeWorklistFull()
+{
+
+    if (worklistFull.chunkLimit == 0) {
+        worklistFull.chunkLimit = GGGGC_MARK_STACK_CHUNKS;
+    }
+    markStackOverflow = 0;
+
+    /* add refs in roots */
+    forEachRoot(markRoot);
+}
+#endif
+
+/* mark what a slot of obj points to, other than its header, and update it */
+static void scanFullSlot(ggc_size_t *obj, ggc_size_t **loc)
+{
+    ggc_size_t *child = getCorrectChild(*loc);
+
+    if (child != NULL) {
+        child = markChild(child);
+    }
+    if (child != *loc) {
+        *loc = child;
+    }
+    if (child != NULL && GEN_OF(obj) == GEN_OF_OLD && GEN_OF(child) != GEN_OF_OLD) {
+        setRememberSet((ggc_size_t *)loc);
+    }
+}
+
+static void scanFull(ggc_size_t *obj)
+{
+	ggc_size_t pWord, pBit, maxWord, pCur, i, ct, *child;
+	ggc_size_t **loc, **end, **slots[GGGGC_BITS_PER_WORD];
+    struct GGGGC_Descriptor *dCur;
+
+    /* slots are updated to forwarded copies as they're found, since an
+     * interrupted young collect may have left some behind that no remembered
+     * bit will lead the re-try young collect to */
+
+    /* deal with the first word first (obj is marked, so keep the mark if
+     * it's in the header) */
+    child = getCorrectChild(*(ggc_size_t **)obj);
+    if (child != NULL) {
+        child = markChild(child);
+    }
+    if (*obj != ((ggc_size_t)child | (*obj & 1))) {
+#ifdef GGGGC_PARALLEL_COLLECT
+        /* another worker may be setting the mark bit at the same time */
+        __atomic_store_n(obj, (ggc_size_t)child | (*obj & 1), __ATOMIC_RELAXED);
+#else
+        *obj = (ggc_size_t)child | (*obj & 1);
+#endif
+    }
+    if (child != NULL && GEN_OF(obj) == GEN_OF_OLD && GEN_OF(child) != GEN_OF_OLD) {
+        setRememberSet((ggc_size_t *)(obj));
+    }
+
+    dCur = (struct GGGGC_Descriptor *)child;
+    /* deal with other refs */
+    switch (dCur->shape) {
+        case GGGGC_SHAPE_TRACER:
+            ct = dCur->tracer(obj, slots);
+            for (i = 0; i < ct; i++) {
+                scanFullSlot(obj, slots[i]);
+            }
+            break;
+
+        case GGGGC_SHAPE_ARRAY:
+            end = (ggc_size_t **)obj + dCur->size;
+            for (loc = (ggc_size_t **)obj + 2; loc < end; loc++) {
+                scanFullSlot(obj, loc);
+            }
+            break;
+
+        case GGGGC_SHAPE_NONE:
+            break;
+
+        default:
+            /* the header's been dealt with */
+            maxWord = (dCur->size - 1)/GGGGC_BITS_PER_WORD;
+            for (pWord = 0; pWord <= maxWord; pWord++) {
+                pCur = pointerWord(dCur, pWord) & (pWord ? (ggc_size_t)-1 : ~(ggc_size_t)1);
+                for (; pCur; pCur &= pCur - 1) {
+                    pBit = lowestBit(pCur);
+                    scanFullSlot(obj, (ggc_size_t **)(obj + pWord*GGGGC_BITS_PER_WORD + pBit));
+                }
+            }
+    }
+}
+
+#ifndef GGGGC_PARALLEL_COLLECT
+/* whether an object is marked, wherever its mark is kept */
+static int isMarkedAnywhere(ggc_size_t *obj)
+{
+    if (GEN_OF(obj) == GEN_OF_OLD) {
+        return isBitmapMarked(obj);
+    }
+    return isMarked(obj);
+}
+
+/* scan a marked object found by a rescan, and everything it leads to */
+static void rescanObject(ggc_size_t *ptr)
+{
+    ggc_size_t *obj;
+
+    if (!isMarkedFo((struct GGGGC_Freeobj *)ptr) && isMarkedAnywhere(ptr)) {
+        scanFull(ptr);
+        while ((obj = popWorklistFull())) {
+            scanFull(obj);
+        }
+    }
+}
+
+/* after a mark stack overflow, walk every pool and rescan its marked
+ * objects, since the ones that were never pushed can't be told apart */
+static void rescanMarked()
+{
+    ggc_size_t *ptr;
+    struct GGGGC_Pool *tempPool;
+    struct GGGGC_PoolOld *tempPoolOld;
+
+    for (tempPoolOld = oldHead; tempPoolOld != oldCur->next; tempPoolOld = tempPoolOld->next) {
+        for (ptr = tempPoolOld->start; ptr < tempPoolOld->free; ptr += walkSize(ptr)) {
+            rescanObject(ptr);
+        }
+    }
+    for (tempPoolOld = largeHead; tempPoolOld; tempPoolOld = tempPoolOld->next) {
+        rescanObject(tempPoolOld->start);
+    }
+    for (tempPool = b0Head; tempPool != b0Cur->next; tempPool = tempPool->next) {
+        for (ptr = tempPool->start; ptr < tempPool->free; ptr += walkSize(ptr)) {
+            rescanObject(ptr);
+        }
+    }
+    for (tempPool = b1FromHead; tempPool != b1FromCur->next; tempPool = tempPool->next) {
+        for (ptr = tempPool->start; ptr < tempPool->free; ptr += walkSize(ptr)) {
+            rescanObject(ptr);
+        }
+    }
+    for (tempPool = b1ToHead; tempPool != b1ToCur->next; tempPool = tempPool->next) {
+        for (ptr = tempPool->start; ptr < tempPool->free; ptr += walkSize(ptr)) {
+            rescanObject(ptr);
+        }
+    }
+}
+#endif
+
+/* turn the dead objects in a young space into free runs, since their
+ * descriptors may be swept and the pools must stay walkable */
+static void fillDeadYoung(struct GGGGC_Pool *head, struct GGGGC_Pool *cur)
+{
+    ggc_size_t *ptr;
+    struct GGGGC_Pool *tempPool;
+    struct GGGGC_Freeobj *newFo;
+
+    for (tempPool = head; tempPool != cur->next; tempPool = tempPool->next) {
+        ptr = tempPool->start;
+        while (ptr < tempPool->free) {
+            if (!isMarkedFo((struct GGGGC_Freeobj *)ptr) && (isMarked(ptr) || forwarded(ptr))) {
+                ptr += walkSize(ptr);
+            }
+            else {
+                /* only selfend is written, a run may be a single word */
+                newFo = (struct GGGGC_Freeobj *)ptr;
+                while (ptr < tempPool->free && (isMarkedFo((struct GGGGC_Freeobj *)ptr) ||
+                                                (!isMarked(ptr) && !forwarded(ptr)))) {
+                    ptr += walkSize(ptr);
+                }
+                newFo->selfend = ptr - 1;
+                markFo(newFo);
+            }
+        }
+    }
+}
+
+/* make the space from ptr to end a free run. Only selfend is written, since
+ * it may be a single word */
+static struct GGGGC_Freeobj *fillFreeRun(ggc_size_t *ptr, ggc_size_t *end)
+{
+    struct GGGGC_Freeobj *newFo = (struct GGGGC_Freeobj *)ptr;
+
+    newFo->selfend = end - 1;
+    markFo(newFo);
+    GGGGC_NOTE_START(newFo);
+    return newFo;
+}
+
+/* make a gap between live objects a free run on a sweep's segment. With
+ * GGGGC_IMMIX_OLD, only the lines wholly in the gap are a hole on the
+ * segment, and the bits of lines at either end, which are partly live, are
+ * free runs of their own that nothing reuses */
+static void sweepGap(ggc_size_t *ptr, ggc_size_t *end, struct GGGGC_SweepSegment *seg)
+{
+    struct GGGGC_Freeobj *newFo;
+#ifdef GGGGC_IMMIX_OLD
+    ggc_size_t *lineStart, *lineEnd;
+
+    lineStart = (ggc_size_t *)(((ggc_size_t)ptr + GGGGC_LINE_BYTES - 1) & ~(ggc_size_t)(GGGGC_LINE_BYTES - 1));
+    lineEnd = (ggc_size_t *)((ggc_size_t)end & ~(ggc_size_t)(GGGGC_LINE_BYTES - 1));
+    if (lineStart >= lineEnd) {
+        fillFreeRun(ptr, end);
+        return;
+    }
+    if (ptr < lineStart) {
+        fillFreeRun(ptr, lineStart);
+    }
+    if (lineEnd < end) {
+        fillFreeRun(lineEnd, end);
+    }
+    ptr = lineStart;
+    end = lineEnd;
+#endif
+
+    newFo = fillFreeRun(ptr, end);
+    newFo->next = NULL;
+    if (seg->tail) {
+        seg->tail->next = newFo;
+    }
+    else {
+        seg->head = newFo;
+    }
+    seg->tail = newFo;
+}
+
+/* sweep an old pool up to end into its own segment of the freelist, and
+ * clear its marks. The free runs are the gaps between marked objects, found
+ * from the bitmap a word at a time, so the dead, whose descriptors may be
+ * gone by a lazy sweep, are never read */
+static void sweepPool(struct GGGGC_PoolOld *tempPool, ggc_size_t *end, struct GGGGC_SweepSegment *seg)
+{
+    ggc_size_t *ptr, *live;
+
+    seg->head = seg->tail = NULL;
+    seg->live = 0;
+
+#ifdef GGGGC_CARD_TABLE
+    /* the dead are gone, so only the starts found now are walkable */
+    memset(tempPool->crossing, GGGGC_CROSSING_NONE, GGGGC_CARDS_PER_POOL);
+#endif
+
+    ptr = tempPool->start;
+    while (ptr < end) {
+        live = tempPool->start + nextMarked(tempPool, ptr - tempPool->start, end - tempPool->start);
+        if (live > ptr) {
+            sweepGap(ptr, live, seg);
+        }
+        ptr = live;
+        if (ptr < end) {
+            GGGGC_NOTE_START(ptr);
+            seg->live += ((struct GGGGC_Header *)ptr)->descriptor__ptr->size;
+            ptr += ((struct GGGGC_Header *)ptr)->descriptor__ptr->size;
+        }
+    }
+
+    memset(tempPool->markBitmap, 0, REMEMBERSET_SIZE*sizeof(ggc_size_t));
+#ifdef GGGGC_EVACUATE_OLD
+    tempPool->survivors = seg->live;
+#endif
+}
+
+/* put a pool's segment on the freelists */
+static void addSegment(struct GGGGC_SweepSegment *seg)
+{
+    struct GGGGC_Freeobj *fo, *next;
+
+    lCtOld += seg->live;
+    for (fo = seg->head; fo; fo = next) {
+        next = fo->next;
+        ggggc_pushFreeRun(fo);
+    }
+}
+
+#ifdef GGGGC_LAZY_SWEEP
+/* and how long the last one's pause was, since its pools are sized only
+ * once they're all swept */
+static ggc_size_t fullPauseNs;
+
+/* the old pools left to sweep, from unswept to lastUnswept, none if unswept
+ * is NULL. lastUnswept was oldCur when they were marked, so it's only swept
+ * up to what its free pointer was then */
+static struct GGGGC_PoolOld *unswept, *lastUnswept;
+static ggc_size_t *lastUnsweptEnd;
+
+/* sweep the next old pool onto the freelists, returns 0 if there's none */
+int ggggc_sweepNext()
+{
+    struct GGGGC_SweepSegment seg;
+    struct GGGGC_PoolOld *tempPool;
+    ggc_size_t *end;
+
+    if (!unswept) {
+        return 0;
+    }
+    tempPool = unswept;
+    if (tempPool == lastUnswept) {
+        end = lastUnsweptEnd;
+        unswept = NULL;
+    }
+    else {
+        end = tempPool->free;
+        unswept = tempPool->next;
+    }
+    sweepPool(tempPool, end, &seg);
+    addSegment(&seg);
+
+    if (!unswept) {
+        /* now that everything's swept, size as an eager sweep would */
+        ggggc_sizeAfterFull(fullPauseNs);
+#ifdef GGGGC_COMPACT_OLD
+        checkFragmentation();
+#endif
+    }
+    return 1;
+}
+
+/* sweep whatever's left, before the old gen is marked again */
+static void finishSweep()
+{
+    while (ggggc_sweepNext());
+}
+#endif
+
+#ifdef GGGGC_PARALLEL_COLLECT
+#ifndef GGGGC_LAZY_SWEEP
+/* each old pool's freelist segment, for a parallel sweep */
+static struct GGGGC_SweepSegment *sweepSegments;
+static ggc_size_t sweepSegmentsSize;
+static volatile ggc_size_t nextSweepTask;
+#endif
+
+/* a worker's share of the mark: roots from the pointer stacks, then
+ * whatever it can pop or steal */
+static void markWorker(struct GGGGC_Worker *worker)
+{
+    ggc_size_t task, i, entry;
+    struct GGGGC_PointerStack *psCur;
+
+    curWorker = worker;
+
+    while ((task = __atomic_fetch_add(&nextRootTask, 1, __ATOMIC_RELAXED)) < rootStackCt) {
+        for (psCur = rootStacks[task]; psCur; psCur = psCur->next) {
+            for (i = 0; i < psCur->size; i++) {
+                markRoot((ggc_size_t **)(psCur->pointers[i]));
+            }
+        }
+    }
+
+    while (1) {
+        entry = ggggc_dequePop(&worker->deque);
+        if (!entry && !(entry = ggggc_findWork(worker))) {
+            break;
+        }
+        scanFull((ggc_size_t *)entry);
+    }
+
+    curWorker = NULL;
+}
+
+#ifndef GGGGC_LAZY_SWEEP
+/* and of the sweep, a pool at a time */
+static void sweepWorker(struct GGGGC_Worker *worker)
+{
+    ggc_size_t task;
+
+    while ((task = __atomic_fetch_add(&nextSweepTask, 1, __ATOMIC_RELAXED)) < rootOldCt) {
+        sweepPool(rootPools[task], rootPools[task]->free, &sweepSegments[task]);
+    }
+}
+#endif
+#endif
+
+/* give back the pools of every large object that wasn't marked, and clear
+ * the marks of the rest. A large object is the only thing in its pool, so
+ * it's never swept lazily */
+static void sweepLarge()
+{
+    struct GGGGC_PoolOld *tempPool, *prev = NULL, *next;
+
+    for (tempPool = largeHead; tempPool; tempPool = next) {
+        next = tempPool->next;
+        if (tempPool->markBitmap[0] & 1) {
+            tempPool->markBitmap[0] = 0;
+            prev = tempPool;
+        }
+        else {
+            ggggc_releaseLargePool(prev, tempPool);
+        }
+    }
+    lCtLarge = pCtLarge;
+    largeGrowth = 0;
+}
+
+/* sweep the old gen into new freelists, and grow it if too little was
+ * freed, with the world stopped. With GGGGC_LAZY_SWEEP, it's only queued to
+ * be swept by ggggc_mallocOld() */
+static void sweepOld()
+{
+    sweepLarge();
+#ifdef GGGGC_LAZY_SWEEP
+	lCtOld = 0;
+    /* the free runs are found again as their pools are swept */
+    ggggc_clearFreelists();
+    unswept = oldHead;
+    lastUnswept = oldCur;
+    lastUnsweptEnd = oldCur->free;
+    fullPauseNs = ggggc_nsTime() - fullStart;
+#else
+	struct GGGGC_PoolOld *prev = NULL;
+#ifdef GGGGC_PARALLEL_COLLECT
+	ggc_size_t i;
+#else
+	struct GGGGC_SweepSegment seg;
+	struct GGGGC_PoolOld *tempPool, *next;
+#endif
+
+	lCtOld = 0;
+    ggggc_clearFreelists();
+#ifdef GGGGC_PARALLEL_COLLECT
+    /* each pool is swept into its own segment, and they're put on the
+     * freelists after */
+    gatherRootTasks();
+    if (sweepSegmentsSize < rootOldCt) {
+        sweepSegments = (struct GGGGC_SweepSegment *)realloc(sweepSegments, rootOldCt*sizeof(struct GGGGC_SweepSegment));
+        if (sweepSegments == NULL) {
+            perror("realloc");
+            abort();
+        }
+        sweepSegmentsSize = rootOldCt;
+    }
+    nextSweepTask = 0;
+    ggggc_runWorkers(sweepWorker);
+    for (i = 0; i < rootOldCt; i++) {
+        if (sweepSegments[i].live == 0 && rootPools[i] != oldCur) {
+            ggggc_releaseOldPool(prev, rootPools[i]);
+        }
+        else {
+            addSegment(&sweepSegments[i]);
+            prev = rootPools[i];
+        }
+    }
+#else
+    for (tempPool = oldHead; tempPool != oldCur->next; tempPool = next) {
+        next = tempPool->next;
+        sweepPool(tempPool, tempPool->free, &seg);
+        /* nothing lived in it, so it's given back, unless it's still
+         * being bumped into */
+        if (seg.live == 0 && tempPool != oldCur) {
+            ggggc_releaseOldPool(prev, tempPool);
+        }
+        else {
+            addSegment(&seg);
+            prev = tempPool;
+        }
+    }
+#endif
+
+    ggggc_sizeAfterFull(ggggc_nsTime() - fullStart);
+#ifdef GGGGC_COMPACT_OLD
+    checkFragmentation();
+#endif
+#endif
+}
+
+/* a full collection, with the world stopped */
+static void collectFull()
+{
+#ifndef GGGGC_PARALLEL_COLLECT
+	ggc_size_t *obj;
+#endif
+
+	fullStart = ggggc_nsTime();
+	ggggc_retireTLABs();
+
+#ifdef GGGGC_LAZY_SWEEP
+	finishSweep();
+#endif
+#ifdef GGGGC_CONCURRENT_MARK
+	/* this collect does the concurrent mark's job for it */
+	abortMark();
+#endif
+
+	inCollectFull = 1;
+	freelisthops = 0;
+	clearRememberSet();
+#ifdef GGGGC_EVACUATE_OLD
+	if (!inCollect) {
+		/* not when a young collect is waiting to go on, since what it's
+		 * copied could be moved out from under it */
+		chooseEvacuation();
+	}
+#endif
+
+	/* mark */
+#ifdef GGGGC_PARALLEL_COLLECT
+	gatherRootTasks();
+	ggggc_runWorkers(markWorker);
+#else
+	initializeWorklistFull();
+	while (1) {
+		while ((obj = popWorklistFull())) {
+			scanFull(obj);
+		}
+		if (!markStackOverflow) {
+			break;
+		}
+		/* let the stack grow so that rescans get rarer */
+		markStackOverflow = 0;
+		worklistFull.chunkLimit *= 2;
+		rescanMarked();
+	}
+	clearWorklist(&worklistFull);
+#endif
+#ifdef GGGGC_EVACUATE_OLD
+	endEvacuation();
+#endif
+
+	/* B1 tospace outlives this collection, and so does B0 if no young
+	 * collection is under way */
+	fillDeadYoung(b1ToHead, b1ToCur);
+	if (!inCollect) {
+		fillDeadYoung(b0Head, b0Cur);
+	}
+
+	/* sweep old gen and build freelists */
+	sweepOld();
+#ifdef GGGGC_CONCURRENT_MARK
+	oldGrowth = 0;
+#endif
+
+    if (inCollect) {
+        /* if ggggc_collectFull() is called by ggggc_collect(), discard the old young worklist */
+        clearWorklist(&worklist);
+        fullInYoungNs += ggggc_nsTime() - fullStart;
+    }
+    else {
+        /* if ggggc_collectFull() is called independently, still need a re-try young collect */
+        collectYoung();
+    }
+}
+
+/* a full collection, by a thread holding ggggc_allocLock */
+void ggggc_collectFullLocked()
+{
+    ggggc_stopWorld();
+    collectFull();
+    ggggc_startWorld();
+}
+
+void ggggc_collectFull()
+{
+    ggggc_registerThread();
+
+    ggc_mutex_lock(&ggggc_allocLock);
+    ggggc_collectFullLocked();
+    ggc_mutex_unlock(&ggggc_allocLock);
+}
+
+/* ggggc_collectFull() */
+/*******************************************************************************************/
+/* concurrent mark */
+
+#ifdef GGGGC_CONCURRENT_MARK
+/* grey old objects, waiting for the marker to scan them */
+static struct GGGGC_Worklist markStack;
+
+/* SATB buffers that have filled up, and emptied ones to reuse */
+static ggc_mutex_t satbLock = GGC_MUTEX_INITIALIZER;
+static struct GGGGC_SATBBuffer *satbFull, *satbSpare;
+
+/* set to start a concurrent mark with the next young collect */
+static volatile char markRequested;
+
+/* the marker thread waits on markerWake between marks */
+static char markerStarted;
+static ggc_sem_t markerWake;
+
+/* grey an old object. Young objects are never traced, since they move:
+ * instead, every young object's children are greyed at each pause */
+static void greyOld(ggc_size_t *obj)
+{
+    if (obj != NULL && GEN_OF(obj) == GEN_OF_OLD && !isBitmapMarked(obj)) {
+        bitmapMark(obj);
+        pushWorklist(&markStack, (ggc_size_t)obj);
+    }
+}
+
+static void greyRoot(ggc_size_t **loc)
+{
+    greyOld(*loc);
+}
+
+/* grey an object's children. For a scanned old object, slots that point to
+ * young objects are remembered, as scanFull() does. The mutators may be
+ * writing the slots, which the SATB barrier makes safe, but the world is
+ * stopped for every young collect, so the young ones can be looked at */
+/* grey what a slot points to, other than the header */
+static void greySlot(ggc_size_t **loc, char remember)
+{
+    ggc_size_t *child = __atomic_load_n(loc, __ATOMIC_RELAXED);
+
+    if (child != NULL) {
+        if (GEN_OF(child) == GEN_OF_OLD) {
+            greyOld(child);
+        }
+        else if (remember) {
+            setRememberSet((ggc_size_t *)loc);
+        }
+    }
+}
+
+static void greyChildren(ggc_size_t *obj, char remember)
+{
+	ggc_size_t pWord, pBit, maxWord, pCur, i, ct;
+	ggc_size_t **loc, **end, **slots[GGGGC_BITS_PER_WORD];
+    struct GGGGC_Descriptor *dCur;
+
+    /* deal with the first word first */
+    dCur = (struct GGGGC_Descriptor *)__atomic_load_n((ggc_size_t **)obj, __ATOMIC_RELAXED);
+    if (GEN_OF(dCur) == GEN_OF_OLD) {
+        greyOld((ggc_size_t *)dCur);
+    }
+    else if (remember) {
+        setRememberSet(obj);
+    }
+
+    /* deal with other refs */
+    switch (dCur->shape) {
+        case GGGGC_SHAPE_TRACER:
+            ct = dCur->tracer(obj, slots);
+            for (i = 0; i < ct; i++) {
+                greySlot(slots[i], remember);
+            }
+            break;
+
+        case GGGGC_SHAPE_ARRAY:
+            end = (ggc_size_t **)obj + dCur->size;
+            for (loc = (ggc_size_t **)obj + 2; loc < end; loc++) {
+                greySlot(loc, remember);
+            }
+            break;
+
+        case GGGGC_SHAPE_NONE:
+            break;
+
+        default:
+            /* the header's been dealt with */
+            maxWord = (dCur->size - 1)/GGGGC_BITS_PER_WORD;
+            for (pWord = 0; pWord <= maxWord; pWord++) {
+                pCur = pointerWord(dCur, pWord) & (pWord ? (ggc_size_t)-1 : ~(ggc_size_t)1);
+                for (; pCur; pCur &= pCur - 1) {
+                    pBit = lowestBit(pCur);
+                    greySlot((ggc_size_t **)(obj + pWord*GGGGC_BITS_PER_WORD + pBit), remember);
+                }
+            }
+    }
+}
+
+/* grey the children of every object in some young pools, dead or alive */
+static void greyYoungPools(struct GGGGC_Pool *head, struct GGGGC_Pool *cur)
+{
+    ggc_size_t *ptr;
+    struct GGGGC_Pool *tempPool;
+
+    for (tempPool = head; tempPool != cur->next; tempPool = tempPool->next) {
+        ptr = tempPool->start;
+        while (ptr < tempPool->free) {
+            if (!isMarkedFo((struct GGGGC_Freeobj *)ptr)) {
+                greyChildren(ptr, 0);
+            }
+            ptr += walkSize(ptr);
+        }
+    }
+}
+
+/* put a thread's SATB buffer with the full ones */
+void ggggc_satbFlush(struct GGGGC_ThreadInfo *ti)
+{
+    if (ti->satb) {
+        ggc_mutex_lock_raw(&satbLock);
+        ti->satb->next = satbFull;
+        satbFull = ti->satb;
+        ggc_mutex_unlock(&satbLock);
+        ti->satb = NULL;
+    }
+}
+
+/* the SATB write barrier's slow path, only taken while marking */
+void ggggc_satbEnqueue(void *ptr)
+{
+    struct GGGGC_SATBBuffer *buf = ggggc_thread.satb;
+
+    if (buf == NULL) {
+        ggc_mutex_lock_raw(&satbLock);
+        buf = satbSpare;
+        if (buf) {
+            satbSpare = buf->next;
+        }
+        ggc_mutex_unlock(&satbLock);
+        if (buf == NULL) {
+            buf = (struct GGGGC_SATBBuffer *)malloc(sizeof(struct GGGGC_SATBBuffer));
+            if (buf == NULL) {
+                perror("malloc");
+                abort();
+            }
+        }
+        buf->ct = 0;
+        ggggc_thread.satb = buf;
+    }
+
+    buf->entries[buf->ct++] = ptr;
+    if (buf->ct == GGGGC_SATB_BUFFER_SIZE) {
+        ggggc_satbFlush(&ggggc_thread);
+    }
+}
+
+/* grey what a list of SATB buffers logged, if grey is set, and keep the
+ * buffers for reuse */
+static void greySATB(struct GGGGC_SATBBuffer *bufs, char grey)
+{
+    ggc_size_t i;
+    struct GGGGC_SATBBuffer *buf;
+
+    while (bufs) {
+        buf = bufs;
+        bufs = buf->next;
+        if (grey) {
+            for (i = 0; i < buf->ct; i++) {
+                greyOld((ggc_size_t *)buf->entries[i]);
+            }
+        }
+        ggc_mutex_lock_raw(&satbLock);
+        buf->next = satbSpare;
+        satbSpare = buf;
+        ggc_mutex_unlock(&satbLock);
+    }
+}
+
+/* take every thread's SATB buffer along with the full ones, with the world
+ * stopped */
+static void takeSATB(char grey)
+{
+    struct GGGGC_ThreadInfo *ti;
+    struct GGGGC_SATBBuffer *bufs;
+
+    for (ti = ggggc_threads; ti; ti = ti->next) {
+        ggggc_satbFlush(ti);
+    }
+    ggc_mutex_lock_raw(&satbLock);
+    bufs = satbFull;
+    satbFull = NULL;
+    ggc_mutex_unlock(&satbLock);
+    greySATB(bufs, grey);
+}
+
+/* at a pause while marking, everything logged and everything the young gen
+ * points to is greyed */
+static void greyYoung()
+{
+    takeSATB(1);
+    greyYoungPools(b0Head, b0Cur);
+    greyYoungPools(b1ToHead, b1ToCur);
+}
+
+/* drop a concurrent mark, with the world stopped */
+static void abortMark()
+{
+    struct GGGGC_PoolOld *tempPool;
+
+    if (!ggggc_marking) {
+        return;
+    }
+    ggggc_marking = 0;
+    clearWorklist(&markStack);
+    takeSATB(0);
+    for (tempPool = oldHead; tempPool != oldCur->next; tempPool = tempPool->next) {
+        memset(tempPool->markBitmap, 0, REMEMBERSET_SIZE*sizeof(ggc_size_t));
+    }
+    for (tempPool = largeHead; tempPool; tempPool = tempPool->next) {
+        tempPool->markBitmap[0] = 0;
+    }
+}
+
+#ifndef GGGGC_CARD_TABLE
+/* forget the remembered slots of the objects a concurrent mark found dead,
+ * since the remember set isn't rebuilt as by a full collect, and a lazy
+ * sweep may free them in the middle of a young collect that's reading them.
+ * Dirty cards need no such care, since the sweep turns the dead into free
+ * runs, which a card's walk skips */
+static void forgetDeadRemembered()
+{
+    ggc_size_t i, offset, from, live, bits;
+    struct GGGGC_PoolOld *tempPool;
+
+    for (tempPool = oldHead; tempPool != oldCur->next; tempPool = tempPool->next) {
+        /* the slots are looked at in order, and every object that starts
+         * before from is already known to end before it */
+        from = 0;
+        for (i = nextRememberedWord(tempPool, 0); i < REMEMBERSET_SIZE; i = nextRememberedWord(tempPool, i + 1)) {
+            bits = tempPool->rememberSet[i];
+            while (bits) {
+                offset = i*GGGGC_BITS_PER_WORD + lowestBit(bits);
+                bits &= bits - 1;
+                while (offset >= from) {
+                    live = nextMarked(tempPool, from, offset + 1);
+                    if (live > offset) {
+                        /* no marked object holds it */
+                        unremember(tempPool, i, (ggc_size_t)1 << (offset%GGGGC_BITS_PER_WORD));
+                        from = offset + 1;
+                    }
+                    else {
+                        from = live + ((struct GGGGC_Header *)(tempPool->start + live))->descriptor__ptr->size;
+                    }
+                }
+            }
+        }
+    }
+    for (tempPool = largeHead; tempPool; tempPool = tempPool->next) {
+        if (!(tempPool->markBitmap[0] & 1)) {
+            memset(tempPool->rememberSet, 0, REMEMBERSET_SIZE*sizeof(ggc_size_t));
+            memset(tempPool->rememberSummary, 0, REMEMBERSUMMARY_SIZE*sizeof(ggc_size_t));
+        }
+    }
+}
+#endif
+
+/* the remark pause: finish the mark with the world stopped, then sweep */
+static void remark()
+{
+    ggc_size_t *obj;
+
+    ggc_mutex_lock(&ggggc_allocLock);
+    ggggc_stopWorld();
+
+    /* a full collect may have dropped this mark meanwhile */
+    if (ggggc_marking) {
+        fullStart = ggggc_nsTime();
+        /* B0 must be walkable */
+        ggggc_retireTLABs();
+        greyYoung();
+        while ((obj = (ggc_size_t *)popWorklist(&markStack))) {
+            greyChildren(obj, 1);
+        }
+        ggggc_marking = 0;
+#ifndef GGGGC_CARD_TABLE
+        forgetDeadRemembered();
+#endif
+
+        freelisthops = 0;
+        sweepOld();
+        oldGrowth = 0;
+    }
+
+    ggggc_startWorld();
+    ggc_mutex_unlock(&ggggc_allocLock);
+}
+
+/* the marker thread, which is registered so that it stops for collections */
+static void *markerThread(void *arg)
+{
+    ggc_size_t *obj;
+    struct GGGGC_SATBBuffer *bufs;
+
+    ggggc_registerThread();
+
+    while (1) {
+        ggc_pre_blocking();
+        ggc_sem_wait_raw(&markerWake);
+        ggc_post_blocking();
+
+        while (ggggc_marking) {
+            if (ggggc_stopTheWorld) {
+                ggggc_safepoint();
+            }
+            else if ((obj = (ggc_size_t *)popWorklist(&markStack))) {
+                greyChildren(obj, 1);
+            }
+            else {
+                /* then what the mutators have logged so far */
+                ggc_mutex_lock_raw(&satbLock);
+                bufs = satbFull;
+                satbFull = NULL;
+                ggc_mutex_unlock(&satbLock);
+                if (bufs) {
+                    greySATB(bufs, 1);
+                }
+                else {
+                    remark();
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+/* start a concurrent mark if promotion has used enough of the old gen's
+ * free space, at the end of a young collect. This is the initial mark: the
+ * roots and the children of the young gen are the snapshot */
+static void startMarkIfDue()
+{
+    ggc_size_t freeWords;
+    pthread_t thread;
+
+    if (ggggc_marking) {
+        return;
+    }
+    freeWords = pCtOld*GGGGC_WORDS_PER_POOL;
+    freeWords = (freeWords > lCtOld) ? freeWords - lCtOld : 0;
+    if (!markRequested && oldGrowth*100 < freeWords*GGGGC_CONCURRENT_MARK_PERCENT) {
+        return;
+    }
+    markRequested = 0;
+
+#ifdef GGGGC_LAZY_SWEEP
+    /* the last mark's bitmaps must be swept away first */
+    finishSweep();
+#endif
+    ggggc_marking = 1;
+    forEachRoot(greyRoot);
+    greyYoungPools(b0Head, b0Cur);
+    greyYoungPools(b1ToHead, b1ToCur);
+
+    if (!markerStarted) {
+        ggc_sem_init(&markerWake, 0);
+        if (pthread_create(&thread, NULL, markerThread, NULL) != 0) {
+            perror("pthread_create");
+            abort();
+        }
+        pthread_detach(thread);
+        markerStarted = 1;
+    }
+    ggc_sem_post(&markerWake);
+}
+#endif
+
+/* concurrent mark */
+/*******************************************************************************************/
+/* ggggc_yield() */
+
+int ggggc_yield()
+{
+    if (ggggc_stopTheWorld) {
+        ggggc_safepoint();
+    }
+    if (freelisthops > 20) {
+#ifdef GGGGC_CONCURRENT_MARK
+        /* a concurrent mark's sweep will rebuild the freelists instead */
+        if (!ggggc_marking) {
+            markRequested = 1;
+        }
+#else
+		ggggc_collectFull();
+#endif
 	}
     return 0;
 }
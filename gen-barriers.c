@@ -18,40 +18,41 @@
 
 int ggc_barrier_destroy(ggc_barrier_t *barrier)
 {
+    ggc_sem_destroy(&barrier->leavers);
     return ggc_sem_destroy(&barrier->waiters);
 }
 
 int ggc_barrier_init(ggc_barrier_t *barrier, unsigned long ct)
 {
-    barrier->lock = GGC_MUTEX_INITIALIZER;
+    ggc_mutex_init(&barrier->lock);
     barrier->cur = 0;
     barrier->ct = ct;
-    ggc_sem_init(&barrier->waiters, ct - 1);
+    ggc_sem_init(&barrier->waiters, 0);
+    ggc_sem_init(&barrier->leavers, 0);
     return 0;
 }
 
 int ggc_barrier_wait_raw(ggc_barrier_t *barrier)
 {
-    ggc_mutex_lock_raw(&barrier->lock);
-
-    /* if we're the last one, great */
-    if (barrier->cur == barrier->ct - 1) {
-        unsigned long i;
+    unsigned long i;
 
-        /* signal all the others */
+    /* wait for everyone to arrive */
+    ggc_mutex_lock_raw(&barrier->lock);
+    if (++barrier->cur == barrier->ct) {
         for (i = 0; i < barrier->ct; i++) ggc_sem_post(&barrier->waiters);
-
-        /* and reset the barrier */
-        barrier->cur = 0;
-        ggc_mutex_unlock(&barrier->lock);
-        return 0;
     }
-
-    /* otherwise, wait on the others */
-    barrier->cur++;
     ggc_mutex_unlock(&barrier->lock);
     ggc_sem_wait_raw(&barrier->waiters);
 
+    /* then for everyone to leave, so that nobody can take another's wakeup
+     * by coming back to the barrier early */
+    ggc_mutex_lock_raw(&barrier->lock);
+    if (--barrier->cur == 0) {
+        for (i = 0; i < barrier->ct; i++) ggc_sem_post(&barrier->leavers);
+    }
+    ggc_mutex_unlock(&barrier->lock);
+    ggc_sem_wait_raw(&barrier->leavers);
+
     return 0;
 }
 
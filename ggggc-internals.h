@@ -25,11 +25,57 @@
 extern "C" {
 #endif
 
-void ggggc_expandB0(void);
+/* set a pool's generation, and its entry in the generation table if there is one */
+#ifdef GGGGC_HEAP_RESERVE
+#define GGGGC_SET_GEN(pool, g) ((pool)->gen = (g), ggggc_poolGens[GGGGC_POOL_INDEX(pool)] = (unsigned char) (g))
+#else
+#define GGGGC_SET_GEN(pool, g) ((pool)->gen = (g))
+#endif
+
 void ggggc_expandB1(int poolsNeed);
 void ggggc_expandOld(int poolsNeed);
+void ggggc_freeGeneration(struct GGGGC_Pool *pool);
+void ggggc_releaseOldPool(struct GGGGC_PoolOld *prev, struct GGGGC_PoolOld *pool);
+void ggggc_releaseLargePool(struct GGGGC_PoolOld *prev, struct GGGGC_PoolOld *pool);
+void ggggc_trimFreePools(void);
+void ggggc_resizeB0(ggc_size_t pools);
+void ggggc_resizeB1(ggc_size_t pools);
+void ggggc_resizeOld(ggc_size_t pools);
+void ggggc_initSizingPolicy(void);
+void ggggc_sizeAfterYoung(ggc_size_t pauseNs);
+void ggggc_sizeAfterFull(ggc_size_t pauseNs);
+ggc_size_t ggggc_nsTime(void);
 void *ggggc_mallocB1(struct GGGGC_Descriptor *descriptor);
 void *ggggc_mallocOld(struct GGGGC_Descriptor *descriptor);
+void ggggc_retireTLAB(struct GGGGC_ThreadInfo *ti);
+void ggggc_retireTLABs(void);
+void ggggc_safepoint(void);
+void ggggc_stopWorld(void);
+void ggggc_startWorld(void);
+void ggggc_collectLocked(void);
+void ggggc_collectFullLocked(void);
+void *ggggc_mallocB1PLAB(ggc_size_t minSize, ggc_size_t *size);
+void *ggggc_mallocOldPLAB(ggc_size_t minSize, ggc_size_t *size);
+void ggggc_dequePush(struct GGGGC_Deque *dq, ggc_size_t entry);
+ggc_size_t ggggc_dequePop(struct GGGGC_Deque *dq);
+ggc_size_t ggggc_dequeSteal(struct GGGGC_Deque *dq);
+ggc_size_t ggggc_findWork(struct GGGGC_Worker *worker);
+void ggggc_runWorkers(void (*job)(struct GGGGC_Worker *worker));
+void ggggc_workersSync(void);
+void ggggc_satbFlush(struct GGGGC_ThreadInfo *ti);
+void ggggc_clearFreelists(void);
+void ggggc_pushFreeRun(struct GGGGC_Freeobj *fo);
+int ggggc_sweepNext(void);
+void ggggc_chooseBitmapScan(void);
+
+#ifdef GGGGC_CARD_TABLE
+/* note that an object or free run starts at ptr, in an old pool, so that
+ * its card can be walked */
+#define GGGGC_NOTE_START(ptr) (GGGGC_POOLOLD_OF(ptr)->crossing[GGGGC_CARD_OF(ptr)] = \
+    (unsigned char) ((((ggc_size_t) (ptr) & (((ggc_size_t) 1 << GGGGC_CARD_SIZE) - 1)))/sizeof(ggc_size_t)))
+#else
+#define GGGGC_NOTE_START(ptr) ((void) 0)
+#endif
 
 ggc_size_t getFoSize(struct GGGGC_Freeobj *obj);
 int forwarded(ggc_size_t *fromRef);
@@ -39,6 +85,7 @@ extern char inCollect;
 extern char inCollectFull;
 extern char mustAllocPool;
 extern char skipFreelist;
+extern char oldFromFreelist;
 extern ggc_size_t freelisthops;
 extern ggc_size_t GEN_OF_B0;
 extern ggc_size_t GEN_OF_B1TO;
@@ -49,9 +96,19 @@ extern ggc_size_t pCtB1;
 extern ggc_size_t pCtOld;
 extern ggc_size_t lCtB1;
 extern ggc_size_t lCtOld;
-extern struct GGGGC_Worklist *worklist;
-extern struct GGGGC_WorklistFull *worklistFull;
-extern struct GGGGC_Freeobj *freelist;
+extern ggc_size_t tenuringThreshold;
+extern struct GGGGC_Worklist worklist;
+extern struct GGGGC_Worklist worklistFull;
+#ifdef GGGGC_IMMIX_OLD
+/* the old gen's holes, in address order, and the one being bumped through */
+extern struct GGGGC_Freeobj *holes;
+extern struct GGGGC_Freeobj *holesTail;
+extern ggc_size_t *holeFree;
+extern ggc_size_t *holeEnd;
+#else
+extern struct GGGGC_Freeobj *freelists[GGGGC_FREELIST_BINS];
+extern ggc_size_t freelistsUsed[(GGGGC_FREELIST_BINS + GGGGC_BITS_PER_WORD - 1)/GGGGC_BITS_PER_WORD];
+#endif
 extern struct GGGGC_Pool *b0Head;
 extern struct GGGGC_Pool *b0End;
 extern struct GGGGC_Pool *b0Cur;
@@ -64,6 +121,28 @@ extern struct GGGGC_Pool *b1FromCur;
 extern struct GGGGC_PoolOld *oldHead;
 extern struct GGGGC_PoolOld *oldEnd;
 extern struct GGGGC_PoolOld *oldCur;
+extern struct GGGGC_PoolOld *largeHead;
+extern ggc_size_t pCtLarge;
+extern ggc_size_t lCtLarge;
+extern ggc_size_t largeGrowth;
+extern ggc_thread_local struct GGGGC_ThreadInfo ggggc_thread;
+extern struct GGGGC_ThreadInfo *ggggc_threads;
+extern ggc_mutex_t ggggc_allocLock;
+extern ggc_mutex_t ggggc_worldLock;
+extern ggc_mutex_t ggggc_collectLock;
+extern volatile char ggggc_stopTheWorld;
+extern ggc_size_t ggggc_runningThreads;
+extern ggc_size_t ggggc_parkedThreads;
+extern ggc_barrier_t ggggc_worldBarrier;
+extern struct GGGGC_SafepointStats ggggc_safepointStats;
+extern struct GGGGC_CollectionStats ggggc_collectionStats;
+extern struct GGGGC_Worker *ggggc_workers;
+extern ggc_size_t ggggc_workerCt;
+extern volatile char ggggc_workersAbort;
+extern ggc_mutex_t ggggc_plabLock;
+extern ggc_mutex_t ggggc_rootsLock;
+extern ggc_mutex_t ggggc_descriptorDescriptorsLock;
+extern ggc_mutex_t ggggc_descriptorSlotsLock;
 extern struct GGGGC_Descriptor *ggggc_descriptorDescriptors[GGGGC_WORDS_PER_POOL/GGGGC_BITS_PER_WORD+sizeof(struct GGGGC_Descriptor)];
 
 #ifdef __cplusplus
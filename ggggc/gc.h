@@ -31,6 +31,8 @@ extern "C" {
 #include <alloca.h>
 #endif
 
+#include "threads.h"
+
 /* flags to disable GCC features */
 #ifdef GGGGC_NO_GNUC_FEATURES
 #define GGGGC_NO_GNUC_CLEANUP 1
@@ -44,7 +46,158 @@ typedef size_t ggc_size_t;
 
 #ifndef GGGGC_POOL_SIZE
 #define GGGGC_POOL_SIZE 24 /* pool size as a power of 2 */
-#define B0_B1_RATIO 1 /* (B0 pools) / (B1 from pools + B1 to pools) */
+#define B0_B1_RATIO 1 /* (B0 pools) / (B1 from pools + B1 to pools), to start with and for the "fixed" sizing policy */
+#endif
+
+#ifndef GGGGC_WORKLIST_CHUNK_SIZE
+#define GGGGC_WORKLIST_CHUNK_SIZE 1022 /* entries per worklist chunk */
+#endif
+
+#ifndef GGGGC_TLAB_WORDS
+#define GGGGC_TLAB_WORDS 2048 /* size of a thread-local allocation buffer, in words */
+#endif
+
+#ifndef GGGGC_FREELIST_SMALL_WORDS
+#define GGGGC_FREELIST_SMALL_WORDS 64 /* free runs up to this many words get a freelist for each size, a power of 2 */
+#endif
+
+#ifndef GGGGC_MARK_STACK_CHUNKS
+#define GGGGC_MARK_STACK_CHUNKS 1024 /* initial chunk limit of the full collection mark stack */
+#endif
+
+/* GGGGC_PARALLEL_COLLECT runs young collections on several GC workers */
+#if defined(GGGGC_PARALLEL_COLLECT) && (!defined(__GNUC__) || defined(GGGGC_CHENEY_SCAN))
+#error GGGGC_PARALLEL_COLLECT needs GCC atomics and the worklist young collect
+#endif
+
+#ifndef GGGGC_GC_WORKERS
+#define GGGGC_GC_WORKERS 0 /* number of GC workers, 0 for one per online CPU */
+#endif
+
+#ifndef GGGGC_PLAB_WORDS
+#define GGGGC_PLAB_WORDS 1024 /* size of a GC worker's promotion-local allocation buffer, in words */
+#endif
+
+#ifndef GGGGC_DEQUE_SIZE
+#define GGGGC_DEQUE_SIZE 4096 /* initial entries in a work-stealing deque, a power of 2 */
+#endif
+
+/* GGGGC_CONCURRENT_MARK marks the old generation in a background thread */
+#if defined(GGGGC_CONCURRENT_MARK) && (!defined(__GNUC__) || defined(GGGGC_NO_THREADS))
+#error GGGGC_CONCURRENT_MARK needs GCC atomics and threads
+#endif
+
+#ifndef GGGGC_CONCURRENT_MARK_PERCENT
+#define GGGGC_CONCURRENT_MARK_PERCENT 50 /* percent of the old gen's free space promotion may use before a concurrent mark starts */
+#endif
+
+#ifndef GGGGC_SATB_BUFFER_SIZE
+#define GGGGC_SATB_BUFFER_SIZE 256 /* entries in a thread's SATB buffer */
+#endif
+
+/* GGGGC_NO_SIMD keeps the sweep's scan of the mark bitmaps to plain words,
+ * rather than the widest vectors the CPU has */
+
+/* GGGGC_LAZY_SWEEP leaves the old generation's sweep to ggggc_mallocOld(), a
+ * pool at a time */
+
+/* GGGGC_CARD_TABLE remembers old-to-young pointers by dirtying a byte per
+ * card, rather than a bit per word. The barrier is then a single store,
+ * but a young collect must walk each dirty card's objects to find them */
+#if defined(GGGGC_CARD_TABLE) && defined(GGGGC_LAZY_SWEEP)
+#error GGGGC_CARD_TABLE walks the old generation, which a lazy sweep leaves unwalkable
+#endif
+
+#ifndef GGGGC_CARD_SIZE
+#define GGGGC_CARD_SIZE 9 /* card size in bytes as a power of 2 */
+#endif
+#if GGGGC_CARD_SIZE > 10
+#error GGGGC_CARD_SIZE is too big for the word offsets within a card to fit in a byte
+#endif
+
+#ifndef GGGGC_TENURING_THRESHOLD
+#define GGGGC_TENURING_THRESHOLD 2 /* young collections an object survives before it's promoted, at most 255 */
+#endif
+#if GGGGC_TENURING_THRESHOLD < 1 || GGGGC_TENURING_THRESHOLD > 255
+#error GGGGC_TENURING_THRESHOLD must be from 1 to 255
+#endif
+
+/* GGGGC_ADAPTIVE_TENURING lowers the tenuring threshold after a young
+ * collection that left B1 fuller than GGGGC_TARGET_SURVIVOR_PERCENT, and
+ * raises it back once survivors fit again */
+
+#ifndef GGGGC_TARGET_SURVIVOR_PERCENT
+#define GGGGC_TARGET_SURVIVOR_PERCENT 50 /* percent of B1 tospace survivors may fill before the tenuring threshold drops */
+#endif
+
+#ifndef GGGGC_GC_TIME_PERCENT
+#define GGGGC_GC_TIME_PERCENT 5 /* default goal for the percent of time spent collecting */
+#endif
+
+#ifndef GGGGC_MAX_PAUSE_MS
+#define GGGGC_MAX_PAUSE_MS 20 /* default goal for the longest pause of the "pause" sizing policy */
+#endif
+
+#ifndef GGGGC_FREE_POOLS_COMMITTED
+#define GGGGC_FREE_POOLS_COMMITTED 4 /* free pools kept ready for reuse; the rest go back to the OS */
+#endif
+
+#ifndef GGGGC_FREE_POOL_IDLE_MS
+#define GGGGC_FREE_POOL_IDLE_MS 1000 /* how long a free pool goes unused before it goes back to the OS anyway */
+#endif
+
+/* objects of GGGGC_LARGE_OBJECT_WORDS or more aren't put in B0, but each in
+ * its own run of pools in the large object space, where they're marked along
+ * with the old generation and never copied. GGGGC_NO_LARGE_OBJECTS puts them
+ * in B0 like the rest.
+ *
+ * Only data can be bigger than a pool: the write barrier finds a slot's
+ * remember set or card from the start of its pool, which past the first pool
+ * of a run is the object itself, so an object with pointers past its first
+ * pool (such as a pointer array of more than about GGGGC_WORDS_PER_POOL
+ * elements) aborts. Large pointer arrays are out of the large object space's
+ * scope; split them into arrays that each fit in a pool */
+#ifndef GGGGC_LARGE_OBJECT_WORDS
+#define GGGGC_LARGE_OBJECT_WORDS (GGGGC_WORDS_PER_POOL/8)
+#endif
+
+/* GGGGC_COMPACT_OLD slides the old generation's objects down to the start of
+ * its pools, and gives back the pools that empties, after a sweep that left
+ * more than GGGGC_COMPACT_PERCENT of its used space in free runs */
+
+#ifndef GGGGC_COMPACT_PERCENT
+#define GGGGC_COMPACT_PERCENT 25 /* percent of the old gen's used space in free runs that makes it due for compaction */
+#endif
+
+/* GGGGC_EVACUATE_OLD has a full collection copy what's live out of the old
+ * pools that were less than GGGGC_EVACUATE_PERCENT full, into the old gen's
+ * unused space, so that the sweep can give them back. Only a full collection
+ * that isn't within a young one evacuates */
+
+#ifndef GGGGC_EVACUATE_PERCENT
+#define GGGGC_EVACUATE_PERCENT 25 /* percent of an old pool that may be in use for it to be evacuated */
+#endif
+
+/* GGGGC_IMMIX_OLD allocates into the old generation as Immix does: the sweep
+ * divides its pools into lines of GGGGC_LINE_BYTES, and each run of lines
+ * with nothing live in it is a hole that's bumped through, in address order,
+ * instead of free runs of any size going on freelists by their size. What's
+ * dead in a line that's still partly live waits until the line's all dead */
+
+#ifndef GGGGC_LINE_BYTES
+#define GGGGC_LINE_BYTES 256 /* the granularity of the old generation's holes with GGGGC_IMMIX_OLD */
+#endif
+
+/* GGGGC_HUGE_PAGES allocates pools with mmap() and asks for transparent huge
+ * pages for them (madvise(MADV_HUGEPAGE)), which needs GGGGC_POOL_SIZE of at
+ * least 21 to help with 2MB huge pages. GGGGC_POPULATE_POOLS faults in each
+ * new pool when it's made, rather than a page at a time as it's first used */
+
+/* GGGGC_HEAP_RESERVE reserves one region of 2^GGGGC_HEAP_RESERVE bytes of
+ * address space up front (e.g. 36 for 64GB), and commits pools from it in
+ * address order, so that GEN_OF() is a lookup in a byte-per-pool table */
+#if defined(GGGGC_HEAP_RESERVE) && GGGGC_HEAP_RESERVE <= GGGGC_POOL_SIZE
+#error GGGGC_HEAP_RESERVE must be bigger than GGGGC_POOL_SIZE
 #endif
 
 /* various sizes and masks */
@@ -57,7 +210,23 @@ typedef size_t ggc_size_t;
 #define GGGGC_BITS_PER_WORD (8*sizeof(ggc_size_t))
 #define GGGGC_WORDS_PER_POOL (GGGGC_POOL_BYTES/sizeof(ggc_size_t))
 #define REMEMBERSET_SIZE ((GGGGC_WORDS_PER_POOL - 1)/(GGGGC_BITS_PER_WORD + 1) + 1)
+#define REMEMBERSUMMARY_SIZE ((REMEMBERSET_SIZE + GGGGC_BITS_PER_WORD - 1)/GGGGC_BITS_PER_WORD)
+#define GGGGC_FREELIST_BINS (GGGGC_FREELIST_SMALL_WORDS/2 + GGGGC_POOL_SIZE)
+#define GGGGC_CARDS_PER_POOL (GGGGC_POOL_BYTES >> GGGGC_CARD_SIZE)
+#define GGGGC_WORDS_PER_CARD (((ggc_size_t) 1 << GGGGC_CARD_SIZE)/sizeof(ggc_size_t))
+#define GGGGC_CARD_OF(ptr) (((ggc_size_t) (ptr) & GGGGC_POOL_INNER_MASK) >> GGGGC_CARD_SIZE)
+#define GGGGC_WORDS_PER_LINE (GGGGC_LINE_BYTES/sizeof(ggc_size_t))
+#define GGGGC_CROSSING_NONE 0xFF /* no object starts in the card */
+#ifdef GGGGC_HEAP_RESERVE
+/* every pool is in one reservation, so a pointer's generation is in a table
+ * by its pool's index there */
+#define GGGGC_POOL_INDEX(ptr) (((ggc_size_t) (ptr) - ggggc_heapBase) >> GGGGC_POOL_SIZE)
+#define GEN_OF(ptr) ((ggc_size_t) ggggc_poolGens[GGGGC_POOL_INDEX(ptr)])
+extern ggc_size_t ggggc_heapBase;
+extern unsigned char ggggc_poolGens[(ggc_size_t) 1 << (GGGGC_HEAP_RESERVE - GGGGC_POOL_SIZE)];
+#else
 #define GEN_OF(ptr) (((struct GGGGC_Pool *) ((ggc_size_t) (ptr) & GGGGC_POOL_OUTER_MASK))->gen)
+#endif
 
 /* an empty defined for all the various conditions in which empty defines are necessary */
 #define GGGGC_EMPTY
@@ -73,8 +242,23 @@ struct GGGGC_Pool {
     /* how much survived the last collection */
     ggc_size_t survivors;
 
+    /* when it was last put on the free pools */
+    ggc_size_t freedAt;
+
     ggc_size_t gen;
 
+#ifdef GGGGC_CARD_TABLE
+    /* only the old gen's cards are ever read, but every pool has them, so
+     * the write barrier needn't know which generation it's writing to */
+    unsigned char cards[GGGGC_CARDS_PER_POOL];
+#endif
+
+#if GGGGC_TENURING_THRESHOLD > 2
+    /* the age of each B1 object, by its start's two-word granule. With a
+     * lower threshold, everything in B1 has survived exactly once */
+    unsigned char ages[GGGGC_WORDS_PER_POOL/2];
+#endif
+
     /* and the actual content */
     ggc_size_t start[1];
 };
@@ -86,30 +270,134 @@ struct GGGGC_PoolOld {
     /* the current free space and end of the pool */
     ggc_size_t *free, *end;
 
-    /* how much survived the last collection */
+    /* how much survived the last collection. With GGGGC_EVACUATE_OLD, that
+     * of the last sweep, plus what's been allocated in it since */
     ggc_size_t survivors;
 
+    /* when it was last put on the free pools */
+    ggc_size_t freedAt;
+
     ggc_size_t gen;
 
-    ggc_size_t maxRememberSetIndex;
+#ifdef GGGGC_CARD_TABLE
+    /* nonzero for a card that may hold a pointer to the young gen, at the
+     * same place as a young pool's */
+    unsigned char cards[GGGGC_CARDS_PER_POOL];
 
-    ggc_size_t minRememberSetIndex;
+    /* the offset in words of an object or free run that starts in each
+     * card, or GGGGC_CROSSING_NONE, so that a card can be walked */
+    unsigned char crossing[GGGGC_CARDS_PER_POOL];
+#else
+    /* a bit for every word of the remember set, set if it may be nonzero */
+    ggc_size_t rememberSummary[REMEMBERSUMMARY_SIZE];
 
     ggc_size_t rememberSet[REMEMBERSET_SIZE];
+#endif
+
+#ifdef GGGGC_EVACUATE_OLD
+    /* set while a full collection is copying its objects out */
+    ggc_size_t evacuate;
+#endif
+
+    /* the marks of its objects, a bit for every word like the remember set */
+    ggc_size_t markBitmap[REMEMBERSET_SIZE];
 
     /* and the actual content */
     ggc_size_t start[1];
 };
 
+/* worklists are stacks of fixed-size chunks, which are kept for reuse by
+ * later collections rather than being freed when emptied */
+struct GGGGC_WorklistChunk {
+    struct GGGGC_WorklistChunk *next;
+    ggc_size_t top;
+    ggc_size_t entries[GGGGC_WORKLIST_CHUNK_SIZE];
+};
+
 struct GGGGC_Worklist {
-    struct GGGGC_Worklist *next;
-    ggc_size_t **loc;
-    char needToRemember;
+    /* the chunk currently being pushed to and popped from */
+    struct GGGGC_WorklistChunk *chunk;
+
+    /* emptied chunks waiting to be reused */
+    struct GGGGC_WorklistChunk *spare;
+
+    /* how many entries were pushed since the last reset */
+    ggc_size_t pushCt;
+
+    /* how many chunks it owns, and how many it may own (0 for no limit) */
+    ggc_size_t chunkCt;
+    ggc_size_t chunkLimit;
+};
+
+/* the free runs found by sweeping one old pool, in address order, and how
+ * many words there were live */
+struct GGGGC_SweepSegment {
+    struct GGGGC_Freeobj *head, *tail;
+    ggc_size_t live;
 };
 
-struct GGGGC_WorklistFull {
-    struct GGGGC_WorklistFull *next;
-    ggc_size_t *obj;
+/* pointers overwritten while a concurrent mark is going, logged by the
+ * write barrier so that everything in the snapshot gets marked */
+struct GGGGC_SATBBuffer {
+    struct GGGGC_SATBBuffer *next;
+    ggc_size_t ct;
+    void *entries[GGGGC_SATB_BUFFER_SIZE];
+};
+
+/* each mutator thread bumps through its own TLAB, carved out of B0 */
+struct GGGGC_ThreadInfo {
+    /* the next registered thread */
+    struct GGGGC_ThreadInfo *next;
+
+    /* this thread's ggggc_pointerStack */
+    struct GGGGC_PointerStack **pointerStack;
+
+    /* the TLAB's free space and end, both NULL if it has none */
+    ggc_size_t *tlabFree, *tlabEnd;
+
+#ifdef GGGGC_CONCURRENT_MARK
+    /* the SATB buffer being filled, NULL if there's none */
+    struct GGGGC_SATBBuffer *satb;
+#endif
+
+    char registered;
+};
+
+/* a Chase-Lev work-stealing deque: its owner pushes and pops at the bottom,
+ * other workers steal from the top. Its array grows by doubling, and the
+ * outgrown ones are kept until the deque is reset, since a thief may still
+ * be reading one */
+struct GGGGC_DequeArray {
+    struct GGGGC_DequeArray *prev;
+    ggc_size_t size;
+    ggc_size_t entries[1];
+};
+
+struct GGGGC_Deque {
+    volatile long top, bottom;
+    struct GGGGC_DequeArray *volatile array;
+};
+
+/* a GC worker, with its deque and its PLABs (promotion-local allocation
+ * buffers) in B1 tospace and the old gen */
+struct GGGGC_Worker {
+    ggc_size_t id;
+    struct GGGGC_Deque deque;
+
+    /* the PLABs' free space and end, both NULL if there's none */
+    ggc_size_t *b1Free, *b1End;
+    ggc_size_t *oldFree, *oldEnd;
+
+    /* words promoted by this worker in this collection */
+    ggc_size_t promoted;
+
+    /* and locations it pushed to be processed */
+    ggc_size_t pushed;
+
+#ifdef GGGGC_ADAPTIVE_TENURING
+    /* words this worker kept in B1 in this collection, by their new age */
+    ggc_size_t survived[GGGGC_TENURING_THRESHOLD];
+#endif
 };
 
 struct GGGGC_Freeobj {
@@ -122,15 +410,28 @@ struct GGGGC_Header {
     struct GGGGC_Descriptor *descriptor__ptr;
 };
 
+/* a type's tracer puts the address of each pointer in an object of the type,
+ * other than its header, in slots, and returns how many there are. There
+ * are at most GGGGC_BITS_PER_WORD */
+typedef ggc_size_t (*GGGGC_Tracer)(ggc_size_t *obj, ggc_size_t ***slots);
+
 /* GGGGC descriptors are GC objects that describe the shape of other GC objects */
 struct GGGGC_Descriptor {
     struct GGGGC_Header header;
     void *user__ptr; /* for the user to use however they please */
     ggc_size_t size; /* size of the described object in words */
+    ggc_size_t shape; /* how the collector finds the pointers, a GGGGC_SHAPE_* */
+    GGGGC_Tracer tracer; /* with GGGGC_SHAPE_TRACER, the type's tracer */
     ggc_size_t pointers[1]; /* location of pointers within the object (as a special
                          * case, if pointers[0]|1==0, this means "no pointers") */
 };
 #define GGGGC_DESCRIPTOR_DESCRIPTION 0x3 /* first two words are pointers */
+
+/* every shape has the header as a pointer, and the rest from: */
+#define GGGGC_SHAPE_BITMAP  0 /* pointers, a bit at a time */
+#define GGGGC_SHAPE_NONE    1 /* nothing, there are no others */
+#define GGGGC_SHAPE_ARRAY   2 /* every word after the length (a pointer array) */
+#define GGGGC_SHAPE_TRACER  3 /* the tracer */
 #define GGGGC_DESCRIPTOR_WORDS_REQ(sz) (((sz) + GGGGC_BITS_PER_WORD - 1) / GGGGC_BITS_PER_WORD)
 
 /* descriptor slots are global locations where descriptors may eventually be
@@ -139,6 +440,7 @@ struct GGGGC_DescriptorSlot {
     struct GGGGC_Descriptor *descriptor;
     ggc_size_t size;
     ggc_size_t pointers;
+    GGGGC_Tracer tracer;
 };
 
 /* pointer stacks are used to assure that pointers on the stack are known */
@@ -172,11 +474,43 @@ static type ## __descriptorSlotConstructor type ## __descriptorSlotConstructorIn
 
 #endif
 
+/* a tracer for a type, from its pointers, which are known at compile time:
+ * the test for each word is constant, so all that's left is a store for each
+ * pointer. GGC_PTR only reaches the first 31 words. GGGGC_NO_TRACERS leaves
+ * types to be traced from their descriptor's bitmap */
+#ifndef GGGGC_NO_TRACERS
+#define GGGGC_TRACE_SLOT(i) \
+    if ((mask >> (i)) & 1) slots[ct++] = (ggc_size_t **) obj + (i);
+#define GGGGC_TRACER(type, pointers) \
+static ggc_size_t type ## __tracer(ggc_size_t *obj, ggc_size_t ***slots) { \
+    const ggc_size_t mask = ((ggc_size_t)0) pointers; \
+    ggc_size_t ct = 0; \
+    GGGGC_TRACE_SLOT(1) GGGGC_TRACE_SLOT(2) GGGGC_TRACE_SLOT(3) \
+    GGGGC_TRACE_SLOT(4) GGGGC_TRACE_SLOT(5) GGGGC_TRACE_SLOT(6) \
+    GGGGC_TRACE_SLOT(7) GGGGC_TRACE_SLOT(8) GGGGC_TRACE_SLOT(9) \
+    GGGGC_TRACE_SLOT(10) GGGGC_TRACE_SLOT(11) GGGGC_TRACE_SLOT(12) \
+    GGGGC_TRACE_SLOT(13) GGGGC_TRACE_SLOT(14) GGGGC_TRACE_SLOT(15) \
+    GGGGC_TRACE_SLOT(16) GGGGC_TRACE_SLOT(17) GGGGC_TRACE_SLOT(18) \
+    GGGGC_TRACE_SLOT(19) GGGGC_TRACE_SLOT(20) GGGGC_TRACE_SLOT(21) \
+    GGGGC_TRACE_SLOT(22) GGGGC_TRACE_SLOT(23) GGGGC_TRACE_SLOT(24) \
+    GGGGC_TRACE_SLOT(25) GGGGC_TRACE_SLOT(26) GGGGC_TRACE_SLOT(27) \
+    GGGGC_TRACE_SLOT(28) GGGGC_TRACE_SLOT(29) GGGGC_TRACE_SLOT(30) \
+    GGGGC_TRACE_SLOT(31) \
+    return ct; \
+}
+#define GGGGC_TRACER_OF(type) type ## __tracer
+#else
+#define GGGGC_TRACER(type, pointers)
+#define GGGGC_TRACER_OF(type) NULL
+#endif
+
 #define GGC_DESCRIPTOR(type, pointers) \
+    GGGGC_TRACER(type, pointers) \
     static struct GGGGC_DescriptorSlot type ## __descriptorSlot = { \
         NULL, \
         (sizeof(struct type ## __ggggc_struct) + sizeof(ggc_size_t) - 1) / sizeof(ggc_size_t), \
-        ((ggc_size_t)0) pointers \
+        ((ggc_size_t)0) pointers, \
+        GGGGC_TRACER_OF(type) \
     }; \
     GGGGC_DESCRIPTOR_CONSTRUCTOR(type)
 #define GGGGC_OFFSETOF(type, member) \
@@ -227,12 +561,32 @@ static type ## __descriptorSlotConstructor type ## __descriptorSlotConstructorIn
 } while(0)
 
 /* write barriers */
+#ifdef GGGGC_CONCURRENT_MARK
+/* snapshot-at-the-beginning: while marking, log the pointer being overwritten */
+#define GGGGC_SATB(object, member) do { \
+    if (ggggc_marking && (object)->member != NULL) ggggc_satbEnqueue((void *) (object)->member); \
+} while(0)
+#else
+#define GGGGC_SATB(object, member) do {} while(0)
+#endif
+#ifdef GGGGC_CARD_TABLE
+/* dirty the card of every pointer write, to whatever generation */
 #define GGGGC_WP(object, member, value) do { \
     GGGGC_ASSERT_ID(object); \
     GGGGC_ASSERT_ID(value); \
+    GGGGC_SATB(object, member); \
+    (object)->member = (value); \
+    GGGGC_POOL_OF(&((object)->member))->cards[GGGGC_CARD_OF(&((object)->member))] = 1; \
+} while(0)
+#else
+#define GGGGC_WP(object, member, value) do { \
+    GGGGC_ASSERT_ID(object); \
+    GGGGC_ASSERT_ID(value); \
+    GGGGC_SATB(object, member); \
     (object)->member = (value); \
     if (value != NULL && GEN_OF(&((object)->member)) == GEN_OF_OLD && GEN_OF(value) != GEN_OF_OLD) {setRememberSet((ggc_size_t *)&((object)->member));} \
 } while(0)
+#endif
 #define GGGGC_WD(object, member, value) do { \
     GGGGC_ASSERT_ID(object); \
     GGGGC_ASSERT_ID(if_not_a_value_then_ ## value); \
@@ -310,6 +664,12 @@ ggc_size_t GEN_OF_OLD;
 
 void setRememberSet(ggc_size_t *loc);
 
+#ifdef GGGGC_CONCURRENT_MARK
+/* set while a concurrent mark is going */
+extern volatile char ggggc_marking;
+void ggggc_satbEnqueue(void *ptr);
+#endif
+
 void ggggc_collect(void);
 
 void ggggc_collectFull(void);
@@ -320,12 +680,81 @@ void ggggc_collectFull(void);
 int ggggc_yield(void);
 #define GGC_YIELD() ggggc_yield()
 
+/* how long stop-the-world collections waited for every other mutator to
+ * reach a safepoint, in nanoseconds */
+struct GGGGC_SafepointStats {
+    ggc_size_t stops;
+    ggc_size_t lastNs, maxNs, totalNs;
+};
+void ggggc_getSafepointStats(struct GGGGC_SafepointStats *stats);
+
+/* the heap's memory. Reserved is every pool the collector has, and
+ * committed leaves out what of the free ones it's given back to the OS */
+struct GGGGC_HeapStats {
+    ggc_size_t reservedBytes, committedBytes;
+    ggc_size_t b0Pools, b1Pools, oldPools, largePools, freePools;
+};
+void ggggc_getHeapStats(struct GGGGC_HeapStats *stats);
+
+/* how many collections of each kind there have been, and how long they took
+ * in all, in nanoseconds. A full collection or compaction within a young
+ * one counts only as itself. Pushed is how many locations the young
+ * collections pushed to be processed, in all */
+struct GGGGC_CollectionStats {
+    ggc_size_t young, youngNs, pushed;
+    ggc_size_t full, fullNs;
+    ggc_size_t compactions, compactNs;
+};
+void ggggc_getCollectionStats(struct GGGGC_CollectionStats *stats);
+
+/* what a heap sizing policy is told after each collection. Times are in
+ * nanoseconds, and sizes in words unless they're pool counts */
+struct GGGGC_SizingStats {
+    char full; /* a full collection, else young */
+    ggc_size_t pauseNs;
+    ggc_size_t mutatorNs; /* since the last collection of the same kind ended */
+    ggc_size_t b0Pools, b1Pools, oldPools;
+    ggc_size_t b1Survivors, promoted; /* young collections only */
+    ggc_size_t oldLive; /* full collections only */
+
+    /* the goals, from GGGGC_GC_TIME_PERCENT and GGGGC_MAX_PAUSE_MS in the
+     * environment, or ggggc_setSizingGoals() */
+    ggc_size_t gcTimePercent, maxPauseNs;
+};
+
+/* a heap sizing policy picks how many pools each generation should have
+ * after a collection, by changing those it's given. B1's are rounded up to
+ * a pair, and no generation shrinks below what's in use */
+struct GGGGC_SizingPolicy {
+    const char *name;
+    void (*resize)(const struct GGGGC_SizingStats *stats,
+                   ggc_size_t *b0Pools, ggc_size_t *b1Pools, ggc_size_t *oldPools);
+};
+
+/* the built-in policy of that name, "fixed", "throughput" or "pause", or
+ * NULL if there's none */
+const struct GGGGC_SizingPolicy *ggggc_sizingPolicy(const char *name);
+
+/* use this policy from the next collection on. Otherwise, it's the one
+ * named by GGGGC_SIZING_POLICY in the environment, or "fixed" */
+void ggggc_setSizingPolicy(const struct GGGGC_SizingPolicy *policy);
+void ggggc_setSizingGoals(ggc_size_t gcTimePercent, ggc_size_t maxPauseMs);
+
 /* to handle global variables, GGC_PUSH them then GGC_GLOBALIZE */
 void ggggc_globalize(void);
 #define GGC_GLOBALIZE() ggggc_globalize()
 
-/* each thread has its own pointer stack, including global references */
-extern struct GGGGC_PointerStack *ggggc_pointerStack, *ggggc_pointerStackGlobals;
+/* each thread has its own pointer stack, and global references are kept
+ * on a separate one */
+extern ggc_thread_local struct GGGGC_PointerStack *ggggc_pointerStack;
+extern struct GGGGC_PointerStack *ggggc_pointerStackGlobals;
+
+/* a thread's first allocation registers it with the collector, but a thread
+ * that touches GC'd pointers before allocating should register itself first,
+ * and every thread should unregister before it exits (ggc_thread_create does
+ * both) */
+void ggggc_registerThread(void);
+void ggggc_unregisterThread(void);
 
 /* macros to push and pop pointers from the pointer stack */
 #define GGGGC_POP() do { \
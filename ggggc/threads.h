@@ -0,0 +1,94 @@
+/*
+ * Thread support for GGGGC
+ *
+ * Copyright (c) 2014, 2015 Gregor Richards
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#ifndef GGGGC_THREADS_H
+#define GGGGC_THREADS_H 1
+
+/* figure out which threading library to use */
+#if !defined(GGGGC_NO_THREADS) && !defined(GGGGC_THREADS_POSIX)
+#if defined(unix) || defined(__unix) || defined(__unix__) || \
+    (defined(__APPLE__) && defined(__MACH__))
+#define GGGGC_THREADS_POSIX 1
+#else
+#define GGGGC_NO_THREADS 1
+#endif
+#endif
+
+#if defined(GGGGC_THREADS_POSIX)
+#include <pthread.h>
+#include <sched.h>
+#include <semaphore.h>
+
+#define ggc_thread_local __thread
+
+typedef pthread_mutex_t ggc_mutex_t;
+#define GGC_MUTEX_INITIALIZER PTHREAD_MUTEX_INITIALIZER
+#define ggc_mutex_init(mutex) pthread_mutex_init((mutex), NULL)
+#define ggc_mutex_lock_raw pthread_mutex_lock
+#define ggc_mutex_trylock pthread_mutex_trylock
+#define ggc_mutex_unlock pthread_mutex_unlock
+
+typedef sem_t ggc_sem_t;
+#define ggc_sem_init(sem, ct) sem_init((sem), 0, (ct))
+#define ggc_sem_destroy sem_destroy
+#define ggc_sem_post sem_post
+#define ggc_sem_wait_raw sem_wait
+
+typedef pthread_t ggc_thread_t;
+#define ggc_thread_yield sched_yield
+
+#elif defined(GGGGC_NO_THREADS)
+#define ggc_thread_local
+
+typedef int ggc_mutex_t;
+#define GGC_MUTEX_INITIALIZER 0
+#define ggc_mutex_init(mutex) (*(mutex) = 0)
+#define ggc_mutex_lock_raw(mutex) 0
+#define ggc_mutex_trylock(mutex) 0
+#define ggc_mutex_unlock(mutex) 0
+
+typedef int ggc_sem_t;
+#define ggc_sem_init(sem, ct) (*(sem) = (ct), 0)
+#define ggc_sem_destroy(sem) 0
+#define ggc_sem_post(sem) ((*(sem))++, 0)
+#define ggc_sem_wait_raw(sem) ((*(sem))--, 0)
+
+typedef int ggc_thread_t;
+#define ggc_thread_yield() 0
+
+#endif
+
+/* a registered thread about to block (other than at a safepoint) says so,
+ * so that collections needn't wait for it, and waits out any collection
+ * before going on */
+void ggc_pre_blocking(void);
+void ggc_post_blocking(void);
+
+/* lock a mutex, which may block */
+int ggc_mutex_lock(ggc_mutex_t *mutex);
+
+#include "gen-barriers.h"
+
+/* create a thread that may use the GC. Its routine gets a plain (not GC'd)
+ * argument, and it's registered as a mutator before the routine runs */
+int ggc_thread_create(ggc_thread_t *thread, void *(*routine)(void *), void *arg);
+
+/* wait for a thread to finish */
+int ggc_thread_join(ggc_thread_t thread);
+
+#endif
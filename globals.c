@@ -1,26 +1,41 @@
 #include "ggggc-internals.h"
 
 /* publics */
-struct GGGGC_PointerStack *ggggc_pointerStack, *ggggc_pointerStackGlobals;
+ggc_thread_local struct GGGGC_PointerStack *ggggc_pointerStack;
+struct GGGGC_PointerStack *ggggc_pointerStackGlobals;
 
 /* internals */
 char inCollect;
 char inCollectFull;
 char mustAllocPool;
 char skipFreelist;
+char oldFromFreelist;
 ggc_size_t freelisthops;
 ggc_size_t GEN_OF_B0;
 ggc_size_t GEN_OF_B1TO;
 ggc_size_t GEN_OF_B1FROM;
 ggc_size_t GEN_OF_OLD;
+#ifdef GGGGC_HEAP_RESERVE
+ggc_size_t ggggc_heapBase;
+unsigned char ggggc_poolGens[(ggc_size_t) 1 << (GGGGC_HEAP_RESERVE - GGGGC_POOL_SIZE)];
+#endif
 ggc_size_t pCtB0;
 ggc_size_t pCtB1;
 ggc_size_t pCtOld;
 ggc_size_t lCtB1;
 ggc_size_t lCtOld;
-struct GGGGC_Worklist *worklist;
-struct GGGGC_WorklistFull *worklistFull;
-struct GGGGC_Freeobj *freelist;
+ggc_size_t tenuringThreshold = GGGGC_TENURING_THRESHOLD;
+struct GGGGC_Worklist worklist;
+struct GGGGC_Worklist worklistFull;
+#ifdef GGGGC_IMMIX_OLD
+struct GGGGC_Freeobj *holes;
+struct GGGGC_Freeobj *holesTail;
+ggc_size_t *holeFree;
+ggc_size_t *holeEnd;
+#else
+struct GGGGC_Freeobj *freelists[GGGGC_FREELIST_BINS];
+ggc_size_t freelistsUsed[(GGGGC_FREELIST_BINS + GGGGC_BITS_PER_WORD - 1)/GGGGC_BITS_PER_WORD];
+#endif
 struct GGGGC_Pool *b0Head;
 struct GGGGC_Pool *b0End;
 struct GGGGC_Pool *b0Cur;
@@ -33,4 +48,29 @@ struct GGGGC_Pool *b1FromCur;
 struct GGGGC_PoolOld *oldHead;
 struct GGGGC_PoolOld *oldEnd;
 struct GGGGC_PoolOld *oldCur;
+struct GGGGC_PoolOld *largeHead;
+ggc_size_t pCtLarge;
+ggc_size_t lCtLarge;
+ggc_size_t largeGrowth;
+ggc_thread_local struct GGGGC_ThreadInfo ggggc_thread;
+struct GGGGC_ThreadInfo *ggggc_threads;
+ggc_mutex_t ggggc_allocLock = GGC_MUTEX_INITIALIZER;
+ggc_mutex_t ggggc_worldLock = GGC_MUTEX_INITIALIZER;
+ggc_mutex_t ggggc_collectLock = GGC_MUTEX_INITIALIZER;
+volatile char ggggc_stopTheWorld;
+ggc_size_t ggggc_runningThreads;
+ggc_size_t ggggc_parkedThreads;
+ggc_barrier_t ggggc_worldBarrier;
+struct GGGGC_SafepointStats ggggc_safepointStats;
+struct GGGGC_CollectionStats ggggc_collectionStats;
+struct GGGGC_Worker *ggggc_workers;
+ggc_size_t ggggc_workerCt;
+volatile char ggggc_workersAbort;
+ggc_mutex_t ggggc_plabLock = GGC_MUTEX_INITIALIZER;
+#ifdef GGGGC_CONCURRENT_MARK
+volatile char ggggc_marking;
+#endif
+ggc_mutex_t ggggc_rootsLock = GGC_MUTEX_INITIALIZER;
+ggc_mutex_t ggggc_descriptorDescriptorsLock = GGC_MUTEX_INITIALIZER;
+ggc_mutex_t ggggc_descriptorSlotsLock = GGC_MUTEX_INITIALIZER;
 struct GGGGC_Descriptor *ggggc_descriptorDescriptors[GGGGC_WORDS_PER_POOL/GGGGC_BITS_PER_WORD+sizeof(struct GGGGC_Descriptor)];
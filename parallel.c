@@ -0,0 +1,290 @@
+/*
+ * GC workers and work-stealing deques, for parallel collection
+ *
+ * Copyright (c) 2014, 2015 Gregor Richards
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include "ggggc/gc.h"
+#include "ggggc-internals.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef GGGGC_PARALLEL_COLLECT
+
+/* the job the workers are running, and how many of them are out of work */
+static void (*workerJob)(struct GGGGC_Worker *worker);
+static volatile ggc_size_t idleWorkers;
+
+/* the other workers wait at workersStart between jobs, and every worker
+ * at workersSync to split a job into phases */
+static ggc_barrier_t workersStart, workersDone, workersSync;
+
+static struct GGGGC_DequeArray *newDequeArray(ggc_size_t size)
+{
+    struct GGGGC_DequeArray *ret;
+
+    ret = (struct GGGGC_DequeArray *)
+        malloc(sizeof(struct GGGGC_DequeArray) + (size - 1) * sizeof(ggc_size_t));
+    if (ret == NULL) {
+        perror("malloc");
+        abort();
+    }
+    ret->prev = NULL;
+    ret->size = size;
+    return ret;
+}
+
+/* double a deque's array, by its owner */
+static struct GGGGC_DequeArray *growDeque(struct GGGGC_Deque *dq, long top, long bottom)
+{
+    struct GGGGC_DequeArray *a, *na;
+    long i;
+
+    a = dq->array;
+    na = newDequeArray(a->size * 2);
+    for (i = top; i < bottom; i++) {
+        na->entries[i & (na->size - 1)] = a->entries[i & (a->size - 1)];
+    }
+    na->prev = a;
+    __atomic_store_n(&dq->array, na, __ATOMIC_RELEASE);
+    return na;
+}
+
+/* empty a deque and free its outgrown arrays, with no workers running */
+static void resetDeque(struct GGGGC_Deque *dq)
+{
+    struct GGGGC_DequeArray *a;
+
+    while ((a = dq->array->prev)) {
+        dq->array->prev = a->prev;
+        free(a);
+    }
+    dq->top = dq->bottom = 0;
+}
+
+/* push an entry on the bottom of a deque, by its owner */
+void ggggc_dequePush(struct GGGGC_Deque *dq, ggc_size_t entry)
+{
+    long top, bottom;
+    struct GGGGC_DequeArray *a;
+
+    bottom = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED);
+    top = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+    a = dq->array;
+    if (bottom - top > (long) a->size - 1) {
+        a = growDeque(dq, top, bottom);
+    }
+    __atomic_store_n(&a->entries[bottom & (a->size - 1)], entry, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&dq->bottom, bottom + 1, __ATOMIC_RELAXED);
+}
+
+/* pop an entry from the bottom of a deque, by its owner, 0 if it's empty */
+ggc_size_t ggggc_dequePop(struct GGGGC_Deque *dq)
+{
+    long top, bottom;
+    struct GGGGC_DequeArray *a;
+    ggc_size_t entry = 0;
+
+    bottom = __atomic_load_n(&dq->bottom, __ATOMIC_RELAXED) - 1;
+    a = dq->array;
+    __atomic_store_n(&dq->bottom, bottom, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    top = __atomic_load_n(&dq->top, __ATOMIC_RELAXED);
+
+    if (top <= bottom) {
+        entry = __atomic_load_n(&a->entries[bottom & (a->size - 1)], __ATOMIC_RELAXED);
+        if (top != bottom) {
+            return entry;
+        }
+        /* the last entry, so race the thieves for it */
+        if (!__atomic_compare_exchange_n(&dq->top, &top, top + 1, 0,
+                                         __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            entry = 0;
+        }
+    }
+    __atomic_store_n(&dq->bottom, bottom + 1, __ATOMIC_RELAXED);
+    return entry;
+}
+
+/* steal an entry from the top of a deque, 0 if it's empty or another thief
+ * got there first */
+ggc_size_t ggggc_dequeSteal(struct GGGGC_Deque *dq)
+{
+    long top, bottom;
+    struct GGGGC_DequeArray *a;
+    ggc_size_t entry;
+
+    top = __atomic_load_n(&dq->top, __ATOMIC_ACQUIRE);
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    bottom = __atomic_load_n(&dq->bottom, __ATOMIC_ACQUIRE);
+    if (top >= bottom) {
+        return 0;
+    }
+
+    a = __atomic_load_n(&dq->array, __ATOMIC_ACQUIRE);
+    entry = __atomic_load_n(&a->entries[top & (a->size - 1)], __ATOMIC_RELAXED);
+    if (!__atomic_compare_exchange_n(&dq->top, &top, top + 1, 0,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return 0;
+    }
+    return entry;
+}
+
+/* steal work for a worker whose own deque is empty. Returns 0 once every
+ * worker is out of work, or the job was abandoned */
+ggc_size_t ggggc_findWork(struct GGGGC_Worker *worker)
+{
+    ggc_size_t i, entry;
+    char idle = 0;
+
+    while (!ggggc_workersAbort) {
+        /* try every other worker, starting with the next one */
+        for (i = 1; i < ggggc_workerCt; i++) {
+            entry = ggggc_dequeSteal(&ggggc_workers[(worker->id + i) % ggggc_workerCt].deque);
+            if (entry) {
+                if (idle) {
+                    __atomic_sub_fetch(&idleWorkers, 1, __ATOMIC_SEQ_CST);
+                }
+                return entry;
+            }
+        }
+
+        /* nobody can make more work once everybody's idle */
+        if (!idle) {
+            idle = 1;
+            __atomic_add_fetch(&idleWorkers, 1, __ATOMIC_SEQ_CST);
+        }
+        if (__atomic_load_n(&idleWorkers, __ATOMIC_SEQ_CST) == ggggc_workerCt) {
+            break;
+        }
+        ggc_thread_yield();
+    }
+
+    return 0;
+}
+
+#ifdef GGGGC_THREADS_POSIX
+/* the loop of every worker but the first, which is the collecting thread */
+static void *workerThread(void *arg)
+{
+    struct GGGGC_Worker *worker = (struct GGGGC_Worker *) arg;
+
+    while (1) {
+        ggc_barrier_wait_raw(&workersStart);
+        workerJob(worker);
+        ggc_barrier_wait_raw(&workersDone);
+    }
+
+    return NULL;
+}
+#endif
+
+/* make the workers, the first time they're needed */
+static void startWorkers()
+{
+    ggc_size_t i, ct;
+#ifdef GGGGC_THREADS_POSIX
+    pthread_t thread;
+    long cpus;
+#endif
+
+    ct = GGGGC_GC_WORKERS;
+#ifdef GGGGC_THREADS_POSIX
+    if (ct == 0) {
+        cpus = sysconf(_SC_NPROCESSORS_ONLN);
+        ct = (cpus > 0) ? (ggc_size_t) cpus : 1;
+    }
+#else
+    ct = 1;
+#endif
+    if (ct == 0) ct = 1;
+
+    ggggc_workers = (struct GGGGC_Worker *) calloc(ct, sizeof(struct GGGGC_Worker));
+    if (ggggc_workers == NULL) {
+        perror("calloc");
+        abort();
+    }
+    for (i = 0; i < ct; i++) {
+        ggggc_workers[i].id = i;
+        ggggc_workers[i].deque.array = newDequeArray(GGGGC_DEQUE_SIZE);
+    }
+    ggggc_workerCt = ct;
+
+#ifdef GGGGC_THREADS_POSIX
+    ggc_barrier_init(&workersStart, ct);
+    ggc_barrier_init(&workersDone, ct);
+    ggc_barrier_init(&workersSync, ct);
+    for (i = 1; i < ct; i++) {
+        if (pthread_create(&thread, NULL, workerThread, &ggggc_workers[i]) != 0) {
+            perror("pthread_create");
+            abort();
+        }
+        pthread_detach(thread);
+    }
+#endif
+}
+
+/* wait for every worker to get this far in the current job */
+void ggggc_workersSync()
+{
+#ifdef GGGGC_THREADS_POSIX
+    if (ggggc_workerCt > 1) {
+        ggc_barrier_wait_raw(&workersSync);
+    }
+#endif
+}
+
+/* run a job on every worker and wait for them all to finish it, with the
+ * world stopped. The calling thread is the first worker */
+void ggggc_runWorkers(void (*job)(struct GGGGC_Worker *worker))
+{
+    ggc_size_t i;
+
+    if (ggggc_workers == NULL) {
+        startWorkers();
+    }
+
+    workerJob = job;
+    idleWorkers = 0;
+    ggggc_workersAbort = 0;
+
+    if (ggggc_workerCt > 1) {
+        ggc_barrier_wait_raw(&workersStart);
+    }
+    job(&ggggc_workers[0]);
+    if (ggggc_workerCt > 1) {
+        ggc_barrier_wait_raw(&workersDone);
+    }
+
+    /* an abandoned job may have left work behind */
+    for (i = 0; i < ggggc_workerCt; i++) {
+        resetDeque(&ggggc_workers[i].deque);
+    }
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif
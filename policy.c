@@ -0,0 +1,289 @@
+/*
+ * Heap sizing policies: how many pools each generation gets
+ *
+ * Copyright (c) 2014, 2015 Gregor Richards
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "ggggc/gc.h"
+#include "ggggc-internals.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* the policy in use, and its goals */
+static const struct GGGGC_SizingPolicy *sizingPolicy;
+static ggc_size_t gcTimePercent = GGGGC_GC_TIME_PERCENT;
+static ggc_size_t maxPauseNs = (ggc_size_t) GGGGC_MAX_PAUSE_MS * 1000000;
+
+/* when the last young and full collections ended */
+static ggc_size_t youngEnd, fullEnd;
+
+/* how much of the time collections of each kind have taken lately, in
+ * hundredths of a percent, for the adaptive policies */
+static ggc_size_t youngCost, fullCost;
+
+/* how much bigger than what's live the old gen is kept, in percent, for
+ * the adaptive policies */
+static ggc_size_t oldHeadroom = 100;
+
+/* the smallest number of pools that fits this many words, with room to spare */
+static ggc_size_t poolsFor(ggc_size_t words)
+{
+    return words/GGGGC_WORDS_PER_POOL + 1;
+}
+
+/* the way it's always been: B1 three times what was promoted, B0 a fixed
+ * ratio of that, and the old gen twice what's live, none of them shrinking */
+static void fixedResize(const struct GGGGC_SizingStats *stats,
+                        ggc_size_t *b0Pools, ggc_size_t *b1Pools, ggc_size_t *oldPools)
+{
+    ggc_size_t need;
+
+    if (stats->full) {
+        need = poolsFor(stats->oldLive * 2);
+        if (need > *oldPools) *oldPools = need;
+        return;
+    }
+
+    /* a pair of pools for each one short */
+    need = poolsFor(stats->promoted * 3);
+    if (need > *b1Pools) *b1Pools += 2 * (need - *b1Pools);
+    need = *b1Pools * B0_B1_RATIO;
+    if (need > *b0Pools) *b0Pools = need;
+}
+
+/* fold a collection's share of the time into a running average, weighting
+ * the newest by a quarter */
+static ggc_size_t updateCost(ggc_size_t cost, const struct GGGGC_SizingStats *stats)
+{
+    ggc_size_t total, now;
+
+    total = stats->pauseNs + stats->mutatorNs;
+    if (total == 0) return cost;
+    now = (ggc_size_t) ((double) stats->pauseNs * 10000 / total);
+    return (cost * 3 + now) / 4;
+}
+
+/* B1 needs room for its survivors, twice over so that they don't spill */
+static ggc_size_t b1PoolsFor(const struct GGGGC_SizingStats *stats)
+{
+    return 2 * poolsFor((stats->b1Survivors + stats->promoted) * 2);
+}
+
+/* grow B0 while young collections take more than their share of the time,
+ * so that there are fewer of them, and shrink it while they take much less.
+ * It's never grown past the size of the old gen */
+static ggc_size_t b0ForThroughput(const struct GGGGC_SizingStats *stats)
+{
+    ggc_size_t pools = stats->b0Pools;
+
+    if (youngCost > stats->gcTimePercent * 100) {
+        if (pools < stats->oldPools) {
+            pools += pools/4 + 1;
+            if (pools > stats->oldPools) pools = stats->oldPools;
+        }
+    }
+    else if (youngCost < stats->gcTimePercent * 25 && pools > 1) {
+        pools -= pools/8 + 1;
+    }
+    return pools ? pools : 1;
+}
+
+/* likewise, more headroom in the old gen means fewer full collections */
+static ggc_size_t oldForThroughput(const struct GGGGC_SizingStats *stats)
+{
+    if (fullCost > stats->gcTimePercent * 100) {
+        if (oldHeadroom < 400) oldHeadroom += oldHeadroom/2;
+    }
+    else if (fullCost < stats->gcTimePercent * 25) {
+        if (oldHeadroom > 50) oldHeadroom -= oldHeadroom/8;
+    }
+    return poolsFor(stats->oldLive / 100 * (100 + oldHeadroom));
+}
+
+/* spend no more than gcTimePercent of the time collecting */
+static void throughputResize(const struct GGGGC_SizingStats *stats,
+                             ggc_size_t *b0Pools, ggc_size_t *b1Pools, ggc_size_t *oldPools)
+{
+    if (stats->full) {
+        *oldPools = oldForThroughput(stats);
+        return;
+    }
+    *b1Pools = b1PoolsFor(stats);
+    *b0Pools = b0ForThroughput(stats);
+}
+
+/* keep pauses under maxPauseNs, and only then mind the time spent. A young
+ * collection copies what survived of B0, so a smaller B0 is a shorter pause;
+ * a full collection sweeps the whole old gen, so less headroom is */
+static void pauseResize(const struct GGGGC_SizingStats *stats,
+                        ggc_size_t *b0Pools, ggc_size_t *b1Pools, ggc_size_t *oldPools)
+{
+    if (stats->full) {
+        if (stats->pauseNs > stats->maxPauseNs) {
+            if (oldHeadroom > 50) oldHeadroom -= oldHeadroom/4;
+            *oldPools = poolsFor(stats->oldLive / 100 * (100 + oldHeadroom));
+        }
+        else if (stats->pauseNs < stats->maxPauseNs/2) {
+            *oldPools = oldForThroughput(stats);
+        }
+        return;
+    }
+
+    *b1Pools = b1PoolsFor(stats);
+    if (stats->pauseNs > stats->maxPauseNs) {
+        *b0Pools -= *b0Pools/4;
+        if (*b0Pools == 0) *b0Pools = 1;
+    }
+    else if (stats->pauseNs < stats->maxPauseNs/2) {
+        *b0Pools = b0ForThroughput(stats);
+    }
+}
+
+static const struct GGGGC_SizingPolicy policies[] = {
+    {"fixed", fixedResize},
+    {"throughput", throughputResize},
+    {"pause", pauseResize},
+    {NULL, NULL}
+};
+
+const struct GGGGC_SizingPolicy *ggggc_sizingPolicy(const char *name)
+{
+    ggc_size_t i;
+    for (i = 0; policies[i].name; i++) {
+        if (!strcmp(policies[i].name, name)) {
+            return &policies[i];
+        }
+    }
+    return NULL;
+}
+
+void ggggc_setSizingPolicy(const struct GGGGC_SizingPolicy *policy)
+{
+    sizingPolicy = policy;
+}
+
+void ggggc_setSizingGoals(ggc_size_t gcTime, ggc_size_t maxPauseMs)
+{
+    gcTimePercent = gcTime;
+    maxPauseNs = maxPauseMs * 1000000;
+}
+
+/* pick the policy and goals from the environment, unless the program
+ * already has */
+void ggggc_initSizingPolicy()
+{
+    const char *env;
+
+    youngEnd = fullEnd = ggggc_nsTime();
+    if (sizingPolicy) {
+        return;
+    }
+
+    if ((env = getenv("GGGGC_GC_TIME_PERCENT"))) {
+        gcTimePercent = strtoul(env, NULL, 10);
+    }
+    if ((env = getenv("GGGGC_MAX_PAUSE_MS"))) {
+        maxPauseNs = strtoul(env, NULL, 10) * 1000000;
+    }
+    if ((env = getenv("GGGGC_SIZING_POLICY"))) {
+        sizingPolicy = ggggc_sizingPolicy(env);
+        if (!sizingPolicy) {
+            fprintf(stderr, "GGGGC: unknown sizing policy %s, using fixed\n", env);
+        }
+    }
+    if (!sizingPolicy) {
+        sizingPolicy = &policies[0];
+    }
+}
+
+/* what every policy is told */
+static void fillStats(struct GGGGC_SizingStats *stats, char full, ggc_size_t pauseNs, ggc_size_t *end)
+{
+    ggc_size_t now = ggggc_nsTime();
+
+    memset(stats, 0, sizeof(struct GGGGC_SizingStats));
+    stats->full = full;
+    stats->pauseNs = pauseNs;
+    stats->mutatorNs = (now - *end > pauseNs) ? now - *end - pauseNs : 0;
+    *end = now;
+    stats->b0Pools = pCtB0;
+    stats->b1Pools = pCtB1;
+    stats->oldPools = pCtOld;
+    stats->gcTimePercent = gcTimePercent;
+    stats->maxPauseNs = maxPauseNs;
+}
+
+/* size the heap after a young collection, with B0 and B1 fromspace empty */
+void ggggc_sizeAfterYoung(ggc_size_t pauseNs)
+{
+    struct GGGGC_SizingStats stats;
+    struct GGGGC_Pool *tempPool;
+    ggc_size_t b0Pools, b1Pools, oldPools;
+
+    ggggc_collectionStats.young++;
+    ggggc_collectionStats.youngNs += pauseNs;
+    fillStats(&stats, 0, pauseNs, &youngEnd);
+    for (tempPool = b1ToHead; tempPool != b1ToCur->next; tempPool = tempPool->next) {
+        stats.b1Survivors += tempPool->free - tempPool->start;
+    }
+    stats.promoted = lCtB1;
+    youngCost = updateCost(youngCost, &stats);
+
+    b0Pools = pCtB0;
+    b1Pools = pCtB1;
+    oldPools = pCtOld;
+    sizingPolicy->resize(&stats, &b0Pools, &b1Pools, &oldPools);
+    ggggc_resizeB1(b1Pools);
+    ggggc_resizeB0(b0Pools);
+    ggggc_resizeOld(oldPools);
+    ggggc_trimFreePools();
+}
+
+/* and after the old gen is swept */
+void ggggc_sizeAfterFull(ggc_size_t pauseNs)
+{
+    struct GGGGC_SizingStats stats;
+    ggc_size_t b0Pools, b1Pools, oldPools;
+
+    ggggc_collectionStats.full++;
+    ggggc_collectionStats.fullNs += pauseNs;
+    fillStats(&stats, 1, pauseNs, &fullEnd);
+    stats.oldLive = lCtOld;
+    fullCost = updateCost(fullCost, &stats);
+
+    b0Pools = pCtB0;
+    b1Pools = pCtB1;
+    oldPools = pCtOld;
+    sizingPolicy->resize(&stats, &b0Pools, &b1Pools, &oldPools);
+    ggggc_resizeOld(oldPools);
+    ggggc_trimFreePools();
+}
+
+void ggggc_getCollectionStats(struct GGGGC_CollectionStats *stats)
+{
+    ggc_mutex_lock(&ggggc_allocLock);
+    *stats = ggggc_collectionStats;
+    ggc_mutex_unlock(&ggggc_allocLock);
+}
+
+#ifdef __cplusplus
+}
+#endif
@@ -22,6 +22,7 @@
 #include <sys/types.h>
 
 #include "ggggc/gc.h"
+#include "ggggc-internals.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -35,19 +36,15 @@ void ggggc_globalize()
     /* make a global copy */
     gPointerStack = (struct GGGGC_PointerStack *)
         malloc(sizeof(struct GGGGC_PointerStack) + ggggc_pointerStack->size * sizeof(void *));
-    gPointerStack->next = NULL;
     gPointerStack->size = ggggc_pointerStack->size;
     memcpy(gPointerStack->pointers, ggggc_pointerStack->pointers, ggggc_pointerStack->size * sizeof(void *));
 
-    /* then add it to the stack */
-    if (!ggggc_pointerStackGlobals) {
-        /* need to find the globals first! */
-        struct GGGGC_PointerStack *cur = ggggc_pointerStack;
-        while (cur->next) cur = cur->next;
-        ggggc_pointerStackGlobals = cur;
-    }
-    ggggc_pointerStackGlobals->next = gPointerStack;
+    /* then add it to the globals, which every collection scans along with
+     * each thread's own stack */
+    ggc_mutex_lock(&ggggc_rootsLock);
+    gPointerStack->next = ggggc_pointerStackGlobals;
     ggggc_pointerStackGlobals = gPointerStack;
+    ggc_mutex_unlock(&ggggc_rootsLock);
 }
 
 #ifdef __cplusplus
@@ -41,6 +41,7 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <sys/time.h>
+#include <sys/resource.h>
 
 #  include "ggggc/gc.h"
 
@@ -148,14 +149,22 @@ static Node MakeTree(int iDepth) {
 }
 
 static void PrintDiagnostics() {
-#if 0
-        long lFreeMemory = Runtime.getRuntime().freeMemory();
-        long lTotalMemory = Runtime.getRuntime().totalMemory();
-
-        System.out.print(" Total memory available="
-                         + lTotalMemory + " bytes");
-        System.out.println("  Free memory=" + lFreeMemory + " bytes");
-#endif
+        struct GGGGC_HeapStats stats;
+        struct GGGGC_CollectionStats cstats;
+        struct rusage usage;
+
+        ggggc_getHeapStats(&stats);
+        printf(" Heap committed=%lu bytes  reserved=%lu bytes\n",
+               (unsigned long) stats.committedBytes,
+               (unsigned long) stats.reservedBytes);
+
+        // page faults and young collection time, to compare pool options
+        // such as GGGGC_HUGE_PAGES and GGGGC_POPULATE_POOLS
+        ggggc_getCollectionStats(&cstats);
+        getrusage(RUSAGE_SELF, &usage);
+        printf(" Minor page faults=%ld  young collections=%lu in %lu msec\n",
+               (long) usage.ru_minflt, (unsigned long) cstats.young,
+               (unsigned long) (cstats.youngNs / 1000000));
 }
 
 static void TimeConstruction(int depth) {
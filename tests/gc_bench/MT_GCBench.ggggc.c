@@ -0,0 +1,315 @@
+// This is adapted from a benchmark written by John Ellis and Pete Kovac
+// of Post Communications.
+// It was modified by Hans Boehm of Silicon Graphics.
+// Translated to C++ 30 May 1997 by William D Clinger of Northeastern Univ.
+// Translated to C 15 March 2000 by Hans Boehm, now at HP Labs.
+// Adapted to run NTHREADS client threads concurrently.  Each
+// thread executes the original benchmark.  12 June 2000  by Hans Boehm.
+//
+//      This is no substitute for real applications.  No actual application
+//      is likely to behave in exactly this way.  However, this benchmark was
+//      designed to be more representative of real applications than other
+//      Java GC benchmarks of which we are aware.
+//      It attempts to model those properties of allocation requests that
+//      are important to current GC techniques.
+//      It is designed to be used either to obtain a single overall performance
+//      number, or to give a more detailed estimate of how collector
+//      performance varies with object lifetimes.  It prints the time
+//      required to allocate and collect balanced binary trees of various
+//      sizes.  Smaller trees result in shorter object lifetimes.  Each cycle
+//      allocates roughly the same amount of memory.
+//      Two data structures are kept around during the entire process, so
+//      that the measured performance is representative of applications
+//      that maintain some live in-memory data.  One of these is a tree
+//      containing many pointers.  The other is a large array containing
+//      double precision floating point numbers.  Both should be of comparable
+//      size.
+//
+//      The results are only really meaningful together with a specification
+//      of how much memory was used.  It is possible to trade memory for
+//      better time performance.  This benchmark should be run in a 32 MB
+//      heap, though we don't currently know how to enforce that uniformly.
+//
+//      Unlike the original Ellis and Kovac benchmark, we do not attempt
+//      measure pause times.  This facility should eventually be added back
+//      in.  There are several reasons for omitting it for now.  The original
+//      implementation depended on assumptions about the thread scheduler
+//      that don't hold uniformly.  The results really measure both the
+//      scheduler and GC.  Pause time measurements tend to not fit well with
+//      current benchmark suites.  As far as we know, none of the current
+//      commercial Java implementations seriously attempt to minimize GC pause
+//      times.
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/time.h>
+#include <sys/resource.h>
+#include <pthread.h>
+
+#  include "ggggc/gc.h"
+
+#ifndef NTHREADS
+#   define NTHREADS 4
+#endif
+#define MAX_NTHREADS 1024
+
+#ifdef PROFIL
+  extern void init_profiling();
+  extern dump_profile();
+#endif
+
+//  These macros were a quick hack for the Macintosh.
+//
+//  #define currentTime() clock()
+//  #define elapsedTime(x) ((1000*(x))/CLOCKS_PER_SEC)
+
+#define currentTime() stats_rtclock()
+#define elapsedTime(x) (x)
+
+/* Get the current time in milliseconds */
+
+unsigned
+stats_rtclock( void )
+{
+  struct timeval t;
+
+  if (gettimeofday( &t, NULL ) == -1)
+    return 0;
+  return (t.tv_sec * 1000 + t.tv_usec / 1000);
+}
+
+static const int kStretchTreeDepth    = 18;      // about 16Mb
+static const int kLongLivedTreeDepth  = 16;  // about 4Mb
+static const int kArraySize  = 500000;  // about 4Mb
+static const int kMinTreeDepth = 4;
+static const int kMaxTreeDepth = 16;
+
+GGC_TYPE(Node)
+    GGC_MPTR(Node, left);
+    GGC_MPTR(Node, right);
+    GGC_MDATA(int, i);
+    GGC_MDATA(int, j);
+GGC_END_TYPE(Node,
+    GGC_PTR(Node, left)
+    GGC_PTR(Node, right)
+    )
+
+#ifdef HOLES
+#   define HOLE() GGC_NEW(Node);
+#else
+#   define HOLE()
+#endif
+
+void init_Node(Node me, Node l, Node r) {
+    GGC_PUSH_3(me, l, r);
+    GGC_WP(me, left, l);
+    GGC_WP(me, right, r);
+    return;
+}
+
+// Nodes used by a tree of a given size
+static int TreeSize(int i) {
+        return ((1 << (i + 1)) - 1);
+}
+
+// Number of iterations to use for a given tree depth
+static int NumIters(int i) {
+        return 2 * TreeSize(kStretchTreeDepth) / TreeSize(i);
+}
+
+// Build tree top down, assigning to older objects.
+static void Populate(int iDepth, Node thisNode) {
+    Node tmp = NULL;
+    GGC_PUSH_2(thisNode, tmp);
+        if (iDepth<=0) {
+                return;
+        } else {
+                iDepth--;
+                tmp = GGC_NEW(Node);
+                  GGC_WP(thisNode, left, tmp); HOLE();
+                tmp = GGC_NEW(Node);
+                  GGC_WP(thisNode, right, tmp); HOLE();
+                Populate (iDepth, GGC_RP(thisNode, left));
+                Populate (iDepth, GGC_RP(thisNode, right));
+        }
+        return;
+}
+
+// Build tree bottom-up
+static Node MakeTree(int iDepth) {
+	Node result = NULL;
+        Node left = NULL;
+        Node right = NULL;
+
+        GGC_PUSH_3(result, left, right);
+        if (iDepth<=0) {
+		result = GGC_NEW(Node); HOLE();
+	    /* result is implicitly initialized in both cases. */
+	    return result;
+        } else {
+            left = MakeTree(iDepth-1);
+            right = MakeTree(iDepth-1);
+		result = GGC_NEW(Node); HOLE();
+	    init_Node(result, left, right);
+
+	    return result;
+        }
+}
+
+static void PrintDiagnostics() {
+        struct GGGGC_HeapStats stats;
+        struct GGGGC_CollectionStats cstats;
+        struct rusage usage;
+
+        ggggc_getHeapStats(&stats);
+        printf(" Heap committed=%lu bytes  reserved=%lu bytes\n",
+               (unsigned long) stats.committedBytes,
+               (unsigned long) stats.reservedBytes);
+
+        ggggc_getCollectionStats(&cstats);
+        getrusage(RUSAGE_SELF, &usage);
+        printf(" Minor page faults=%ld  young collections=%lu in %lu msec\n",
+               (long) usage.ru_minflt, (unsigned long) cstats.young,
+               (unsigned long) (cstats.youngNs / 1000000));
+}
+
+static void TimeConstruction(int depth) {
+        long    tStart, tFinish;
+        int     iNumIters = NumIters(depth);
+        Node    tempTree = NULL;
+	int 	i;
+
+        GGC_PUSH_1(tempTree);
+
+	printf("0x%lx: Creating %d trees of depth %d\n", (unsigned long) pthread_self(), iNumIters, depth);
+        
+        tStart = currentTime();
+        for (i = 0; i < iNumIters; ++i) {
+                  tempTree = GGC_NEW(Node);
+                Populate(depth, tempTree);
+                tempTree = 0;
+        }
+        tFinish = currentTime();
+        printf("\t0x%lx: Top down construction took %d msec\n",
+               (unsigned long) pthread_self(), (int) elapsedTime(tFinish - tStart));
+             
+        tStart = currentTime();
+        for (i = 0; i < iNumIters; ++i) {
+                tempTree = MakeTree(depth);
+                tempTree = 0;
+        }
+        tFinish = currentTime();
+        printf("\t0x%lx: Bottom up construction took %d msec\n",
+               (unsigned long) pthread_self(), (int) elapsedTime(tFinish - tStart));
+
+    return;
+
+}
+
+// Count the nodes of a tree, to check it survived the collections
+static int CountNodes(Node node) {
+        int ct;
+        GGC_PUSH_1(node);
+        if (node == 0)
+                return 0;
+        ct = 1 + CountNodes(GGC_RP(node, left));
+        ct += CountNodes(GGC_RP(node, right));
+        return ct;
+}
+
+static void *run_one_test(void *arg) {
+        Node    longLivedTree = NULL;
+        Node    tempTree = NULL;
+  	int	i, d;
+	GGC_double_Array array = NULL;
+
+        GGC_PUSH_3(longLivedTree, tempTree, array);
+
+        // Stretch the memory space quickly
+        tempTree = MakeTree(kStretchTreeDepth);
+        tempTree = 0;
+
+        // Create a long lived object
+        printf(" Creating a long-lived binary tree of depth %d\n",
+               kLongLivedTreeDepth);
+          longLivedTree = GGC_NEW(Node);
+        Populate(kLongLivedTreeDepth, longLivedTree);
+
+        // Create long-lived array, filling half of it
+	printf(" Creating a long-lived array of %d doubles\n", kArraySize);
+            array = GGC_NEW_DA(double, kArraySize);
+        for (i = 0; i < kArraySize/2; ++i) {
+                double tval = 1.0/i;
+                GGC_WAD(array, i, tval);
+        }
+
+        for (d = kMinTreeDepth; d <= kMaxTreeDepth; d += 2) {
+                TimeConstruction(d);
+        }
+
+        if (CountNodes(longLivedTree) != TreeSize(kLongLivedTreeDepth) ||
+            GGC_RAD(array, 1000) != 1.0/1000) {
+		fprintf(stderr, "Failed\n");
+                exit(1);
+        }
+
+        return arg;
+}
+
+int main(int argc, char **argv) {
+        long    tStart, tFinish;
+        long    tElapsed;
+  	int	i, nthreads;
+        ggc_thread_t thread[MAX_NTHREADS];
+        struct GGGGC_SafepointStats stats;
+
+        nthreads = NTHREADS;
+        if (argc > 1) {
+                nthreads = atoi(argv[1]);
+                if (nthreads < 1 || nthreads > MAX_NTHREADS) {
+                        fprintf(stderr, "Invalid # of threads argument\n");
+                        exit(1);
+                }
+        }
+
+	printf("Garbage Collector Test\n");
+ 	printf(" Live storage will peak at %d bytes or less .\n\n",
+               (int) (2 * sizeof(Node) * TreeSize(kLongLivedTreeDepth) +
+               sizeof(double) * kArraySize) * nthreads);
+        printf(" Stretching memory with a binary tree of depth %d\n",
+               kStretchTreeDepth);
+        PrintDiagnostics();
+#	ifdef PROFIL
+	    init_profiling();
+#	endif
+
+        tStart = currentTime();
+
+        for (i = 0; i < nthreads; ++i) {
+                if (ggc_thread_create(thread+i, run_one_test, 0) != 0) {
+                        fprintf(stderr, "Thread creation failed\n");
+                        exit(1);
+                }
+        }
+        for (i = 0; i < nthreads; ++i) {
+                if (ggc_thread_join(thread[i]) != 0) {
+                        fprintf(stderr, "Thread join failed\n");
+                        exit(1);
+                }
+        }
+
+        tFinish = currentTime();
+        tElapsed = elapsedTime(tFinish-tStart);
+        PrintDiagnostics();
+        printf("Completed in %d msec\n", (int) tElapsed);
+
+        ggggc_getSafepointStats(&stats);
+        printf("Stopped the world %lu times, time to safepoint: max %lu usec, mean %lu usec\n",
+               (unsigned long) stats.stops, (unsigned long) stats.maxNs / 1000,
+               (unsigned long) (stats.stops ? stats.totalNs / stats.stops / 1000 : 0));
+#	ifdef PROFIL
+	  dump_profile();
+#	endif
+
+    return 0;
+}
@@ -0,0 +1,102 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ggggc/gc.h"
+
+/* large objects are allocated and dropped over and over, a few live at a
+ * time, in runs of several pools of varying length; the heap mustn't grow
+ * with the number allocated */
+
+GGC_TYPE(Box)
+    GGC_MPTR(Box, next);
+    GGC_MDATA(long, val);
+GGC_END_TYPE(Box,
+    GGC_PTR(Box, next)
+    )
+
+#define ITERS 100
+#define LIVE 3
+
+/* runs of one to three and a half pools */
+static ggc_size_t lengthOf(int i)
+{
+    return (GGGGC_WORDS_PER_POOL/2) * (2 + i%6);
+}
+
+static int check(GGC_double_Array arr, int i)
+{
+    ggc_size_t j, len = arr->length;
+    for (j = 0; j < len; j += len/16) {
+        if (GGC_RAD(arr, j) != (double) (i + j)) return 0;
+    }
+    return GGC_RAD(arr, len-1) == (double) i;
+}
+
+int main(void)
+{
+    GGC_voidpArray live = NULL;
+    GGC_double_Array arr = NULL;
+    BoxArray boxes = NULL;
+    Box box = NULL;
+    struct GGGGC_HeapStats hs;
+    ggc_size_t j, len, bound;
+    double d;
+    int i;
+
+    GGC_PUSH_4(live, arr, boxes, box);
+
+    live = GGC_NEW_PA(GGC_voidp, LIVE);
+
+    /* a pointer array that's large but fits in a pool, whose young
+     * referents must survive young collections */
+    boxes = GGC_NEW_PA(Box, GGGGC_LARGE_OBJECT_WORDS);
+
+    for (i = 0; i < ITERS; i++) {
+        /* the one this replaces must still be intact */
+        arr = (GGC_double_Array) GGC_RAP(live, i%LIVE);
+        if (arr && !check(arr, i - LIVE)) {
+            fprintf(stderr, "ERROR! Large array %d was corrupted!\n", i - LIVE);
+            return 1;
+        }
+
+        len = lengthOf(i);
+        arr = GGC_NEW_DA(double, len);
+        for (j = 0; j < len; j += len/16) {
+            d = (double) (i + j);
+            GGC_WAD(arr, j, d);
+        }
+        d = (double) i;
+        GGC_WAD(arr, len-1, d);
+        GGC_WAP(live, i%LIVE, arr);
+
+        for (j = 0; j < 64; j++) {
+            box = GGC_NEW(Box);
+            GGC_WD(box, val, i);
+            GGC_WAP(boxes, (i*64 + j) % boxes->length, box);
+        }
+    }
+
+    for (j = 0; j < boxes->length; j++) {
+        box = GGC_RAP(boxes, j);
+        if (box && GGC_RD(box, val) < 0) {
+            fprintf(stderr, "ERROR! Box %d was corrupted!\n", (int) j);
+            return 1;
+        }
+    }
+
+    /* what's live, as much again in garbage before a full collection, and
+     * the rest of the heap, with room to spare; every run allocated would
+     * be hundreds of pools */
+    ggggc_getHeapStats(&hs);
+    bound = 64 * GGGGC_POOL_BYTES;
+    printf("reserved %luMB, %lu large pools, %lu free pools\n",
+           (unsigned long) (hs.reservedBytes >> 20),
+           (unsigned long) hs.largePools, (unsigned long) hs.freePools);
+    if (hs.reservedBytes > bound) {
+        fprintf(stderr, "ERROR! The heap grew to %luMB for %d live large objects!\n",
+                (unsigned long) (hs.reservedBytes >> 20), LIVE);
+        return 1;
+    }
+
+    return 0;
+}
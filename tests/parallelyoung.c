@@ -0,0 +1,145 @@
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "ggggc/gc.h"
+#include "ggggc/threads.h"
+
+/* a test of young collections with many survivors, reached from the roots of
+ * several mutator threads and from old tables through the remember set. Build
+ * it and the library with -DGGGGC_PARALLEL_COLLECT (e.g. make
+ * ECFLAGS=-DGGGGC_PARALLEL_COLLECT) to test the parallel young collector;
+ * otherwise it tests the serial one */
+
+GGC_TYPE(Tree)
+    GGC_MPTR(Tree, left);
+    GGC_MPTR(Tree, right);
+    GGC_MDATA(long, val);
+GGC_END_TYPE(Tree,
+    GGC_PTR(Tree, left)
+    GGC_PTR(Tree, right)
+    )
+
+#define THREADS 4
+#define SLOTS 1024
+#define DEPTH 6
+#define ITERS 40000
+
+static Tree build(int depth, long val)
+{
+    Tree ret = NULL, child = NULL;
+
+    GGC_PUSH_2(ret, child);
+
+    ret = GGC_NEW(Tree);
+    GGC_WD(ret, val, val);
+    if (depth > 0) {
+        child = build(depth - 1, val*2);
+        GGC_WP(ret, left, child);
+        child = build(depth - 1, val*2 + 1);
+        GGC_WP(ret, right, child);
+    }
+
+    return ret;
+}
+
+/* the sum of a tree's values, -1 if its shape is wrong */
+static long sum(Tree tree, int depth)
+{
+    Tree left = NULL, right = NULL;
+    long l, r;
+
+    GGC_PUSH_3(tree, left, right);
+
+    left = GGC_RP(tree, left);
+    right = GGC_RP(tree, right);
+    if (depth == 0) {
+        return (left || right) ? -1 : GGC_RD(tree, val);
+    }
+    if (!left || !right) return -1;
+    l = sum(left, depth - 1);
+    r = sum(right, depth - 1);
+    if (l < 0 || r < 0) return -1;
+    return GGC_RD(tree, val) + l + r;
+}
+
+/* the sum of a tree of depth rooted at val */
+static long expected(int depth, long val)
+{
+    if (depth == 0) return val;
+    return val + expected(depth - 1, val*2) + expected(depth - 1, val*2 + 1);
+}
+
+static void *mutator(void *arg)
+{
+    long id = (long) arg;
+    TreeArray table = NULL;
+    Tree tree = NULL;
+    long vals[SLOTS];
+    unsigned long rs = 12345 + id;
+    long i, j, k;
+
+    GGC_PUSH_2(table, tree);
+
+    table = GGC_NEW_PA(Tree, SLOTS);
+    for (j = 0; j < SLOTS; j++) {
+        vals[j] = 1;
+        tree = build(DEPTH, vals[j]);
+        GGC_WAP(table, j, tree);
+    }
+
+    for (i = 0; i < ITERS; i++) {
+        rs = rs * 6364136223846793005UL + 1442695040888963407UL;
+        k = (rs >> 33) % SLOTS;
+
+        /* a young tree in a table that's been promoted */
+        vals[k] = (long) (rs >> 40) % 1000 + 1;
+        tree = build(DEPTH, vals[k]);
+        GGC_WAP(table, k, tree);
+
+        /* and garbage */
+        tree = build(DEPTH - 2, 0);
+
+        if (i % (ITERS/8) == 0) {
+            for (j = 0; j < SLOTS; j++) {
+                tree = GGC_RAP(table, j);
+                if (sum(tree, DEPTH) != expected(DEPTH, vals[j])) {
+                    fprintf(stderr, "ERROR! Thread %ld's tree %ld was corrupted!\n", id, j);
+                    exit(1);
+                }
+            }
+        }
+    }
+
+    return NULL;
+}
+
+int main(void)
+{
+    ggc_thread_t threads[THREADS];
+    struct GGGGC_CollectionStats cs;
+    long i;
+
+#ifndef GGGGC_PARALLEL_COLLECT
+    printf("(without GGGGC_PARALLEL_COLLECT, so this is the serial collector)\n");
+#endif
+
+    for (i = 0; i < THREADS; i++) {
+        if (ggc_thread_create(&threads[i], mutator, (void *) i) != 0) {
+            perror("ggc_thread_create");
+            return 1;
+        }
+    }
+    for (i = 0; i < THREADS; i++) {
+        ggc_thread_join(threads[i]);
+    }
+
+    ggggc_getCollectionStats(&cs);
+    printf("%lu young collections, %lu locations pushed\n",
+           (unsigned long) cs.young, (unsigned long) cs.pushed);
+    if (cs.young == 0 || cs.pushed == 0) {
+        fprintf(stderr, "ERROR! The young collections found nothing to copy!\n");
+        return 1;
+    }
+
+    return 0;
+}
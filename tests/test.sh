@@ -24,12 +24,14 @@ doTests() {
 
     cd tests
     make clean
-    make btggggc btggggcth badlll ggggcbench \
+    make btggggc btggggcth badlll largeobjs parallelyoung ggggcbench \
         CC="$2" ECFLAGS="$3" GGGGC_LIBS="$GGGGC_LIBS"
 
     eRun ./btggggc 16
     eRun ./btggggcth 16
     eRun ./badlll
+    eRun ./largeobjs
+    eRun ./parallelyoung
     eRun ./ggggcbench
     )
 }
@@ -57,6 +59,7 @@ else
         doTests "$patch" gcc '-DGGGGC_GENERATIONS=1'
         doTests "$patch" gcc '-DGGGGC_GENERATIONS=5'
         doTests "$patch" gcc '-DGGGGC_USE_MALLOC'
+        doTests "$patch" gcc '-DGGGGC_PARALLEL_COLLECT'
     done
 
 fi
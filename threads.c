@@ -0,0 +1,277 @@
+/*
+ * Thread support
+ *
+ * Copyright (c) 2014, 2015 Gregor Richards
+ *
+ * Permission to use, copy, modify, and/or distribute this software for any
+ * purpose with or without fee is hereby granted, provided that the above
+ * copyright notice and this permission notice appear in all copies.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS" AND THE AUTHOR DISCLAIMS ALL WARRANTIES
+ * WITH REGARD TO THIS SOFTWARE INCLUDING ALL IMPLIED WARRANTIES OF
+ * MERCHANTABILITY AND FITNESS. IN NO EVENT SHALL THE AUTHOR BE LIABLE FOR ANY
+ * SPECIAL, DIRECT, INDIRECT, OR CONSEQUENTIAL DAMAGES OR ANY DAMAGES
+ * WHATSOEVER RESULTING FROM LOSS OF USE, DATA OR PROFITS, WHETHER IN AN ACTION
+ * OF CONTRACT, NEGLIGENCE OR OTHER TORTIOUS ACTION, ARISING OUT OF OR IN
+ * CONNECTION WITH THE USE OR PERFORMANCE OF THIS SOFTWARE.
+ */
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <time.h>
+
+#include "ggggc/gc.h"
+#include "ggggc-internals.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#include "gen-barriers.c"
+
+/* whether ggggc_worldBarrier has been made yet */
+static char worldBarrierInit;
+
+/* nanoseconds on a monotonic clock */
+ggc_size_t ggggc_nsTime()
+{
+#if defined(GGGGC_THREADS_POSIX)
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (ggc_size_t) ts.tv_sec * 1000000000 + ts.tv_nsec;
+#else
+    return 0;
+#endif
+}
+
+/* stop every other running mutator at a safepoint, by a registered thread
+ * holding ggggc_allocLock. Threads that are blocked aren't waited for, but
+ * can't come back until ggggc_startWorld() */
+void ggggc_stopWorld()
+{
+    ggc_size_t start, ns;
+
+    start = ggggc_nsTime();
+
+    ggc_mutex_lock_raw(&ggggc_worldLock);
+
+    /* the threads parked by the last collection must all be out of the
+     * barrier before it's remade */
+    while (ggggc_parkedThreads) {
+        ggc_mutex_unlock(&ggggc_worldLock);
+        ggc_thread_yield();
+        ggc_mutex_lock_raw(&ggggc_worldLock);
+    }
+
+    ggc_mutex_lock_raw(&ggggc_collectLock);
+    ggggc_stopTheWorld = 1;
+    if (worldBarrierInit) {
+        ggc_barrier_destroy(&ggggc_worldBarrier);
+    }
+    ggc_barrier_init(&ggggc_worldBarrier, ggggc_runningThreads);
+    worldBarrierInit = 1;
+    ggc_mutex_unlock(&ggggc_worldLock);
+
+    /* wait for everyone else to get to a safepoint */
+    ggc_barrier_wait_raw(&ggggc_worldBarrier);
+
+    ns = ggggc_nsTime() - start;
+    ggggc_safepointStats.stops++;
+    ggggc_safepointStats.lastNs = ns;
+    ggggc_safepointStats.totalNs += ns;
+    if (ns > ggggc_safepointStats.maxNs) {
+        ggggc_safepointStats.maxNs = ns;
+    }
+}
+
+/* and let them go again */
+void ggggc_startWorld()
+{
+    ggc_mutex_lock_raw(&ggggc_worldLock);
+    ggggc_stopTheWorld = 0;
+    ggc_mutex_unlock(&ggggc_worldLock);
+    ggc_mutex_unlock(&ggggc_collectLock);
+}
+
+/* park this thread for a collection, if one wants it. Its pointer stack is
+ * already where the collector can see it */
+void ggggc_safepoint()
+{
+    ggc_mutex_lock_raw(&ggggc_worldLock);
+    if (!ggggc_stopTheWorld || !ggggc_thread.registered) {
+        ggc_mutex_unlock(&ggggc_worldLock);
+        return;
+    }
+    ggggc_parkedThreads++;
+    ggc_mutex_unlock(&ggggc_worldLock);
+
+    ggc_barrier_wait_raw(&ggggc_worldBarrier);
+
+    /* the collector holds this until the world is started again */
+    ggc_mutex_lock_raw(&ggggc_collectLock);
+    ggc_mutex_unlock(&ggggc_collectLock);
+
+    ggc_mutex_lock_raw(&ggggc_worldLock);
+    ggggc_parkedThreads--;
+    ggc_mutex_unlock(&ggggc_worldLock);
+}
+
+void ggc_pre_blocking()
+{
+    if (!ggggc_thread.registered) return;
+
+    ggc_mutex_lock_raw(&ggggc_worldLock);
+    while (ggggc_stopTheWorld) {
+        /* a collection is already waiting for us, so join it first */
+        ggc_mutex_unlock(&ggggc_worldLock);
+        ggggc_safepoint();
+        ggc_mutex_lock_raw(&ggggc_worldLock);
+    }
+    ggggc_runningThreads--;
+    ggc_mutex_unlock(&ggggc_worldLock);
+}
+
+void ggc_post_blocking()
+{
+    if (!ggggc_thread.registered) return;
+
+    ggc_mutex_lock_raw(&ggggc_worldLock);
+    while (ggggc_stopTheWorld) {
+        /* a collection that isn't waiting for us is going, so wait it out */
+        ggc_mutex_unlock(&ggggc_worldLock);
+        ggc_mutex_lock_raw(&ggggc_collectLock);
+        ggc_mutex_unlock(&ggggc_collectLock);
+        ggc_mutex_lock_raw(&ggggc_worldLock);
+    }
+    ggggc_runningThreads++;
+    ggc_mutex_unlock(&ggggc_worldLock);
+}
+
+int ggc_mutex_lock(ggc_mutex_t *mutex)
+{
+    int ret;
+
+    /* don't bother the collector if it's free */
+    if (ggc_mutex_trylock(mutex) == 0) return 0;
+
+    ggc_pre_blocking();
+    ret = ggc_mutex_lock_raw(mutex);
+    ggc_post_blocking();
+    return ret;
+}
+
+void ggggc_getSafepointStats(struct GGGGC_SafepointStats *stats)
+{
+    ggc_mutex_lock(&ggggc_allocLock);
+    *stats = ggggc_safepointStats;
+    ggc_mutex_unlock(&ggggc_allocLock);
+}
+
+/* add this thread to the ones the collector knows about */
+void ggggc_registerThread()
+{
+    if (ggggc_thread.registered) return;
+
+    ggc_mutex_lock(&ggggc_allocLock);
+    ggggc_thread.pointerStack = &ggggc_pointerStack;
+    ggggc_thread.tlabFree = ggggc_thread.tlabEnd = NULL;
+    ggggc_thread.next = ggggc_threads;
+    ggggc_threads = &ggggc_thread;
+
+    /* no collection can be going, since they hold ggggc_allocLock */
+    ggc_mutex_lock_raw(&ggggc_worldLock);
+    ggggc_runningThreads++;
+    ggggc_thread.registered = 1;
+    ggc_mutex_unlock(&ggggc_worldLock);
+    ggc_mutex_unlock(&ggggc_allocLock);
+}
+
+/* and remove it, giving back its TLAB */
+void ggggc_unregisterThread()
+{
+    struct GGGGC_ThreadInfo **ti;
+
+    if (!ggggc_thread.registered) return;
+
+    ggc_mutex_lock(&ggggc_allocLock);
+    ggggc_retireTLAB(&ggggc_thread);
+#ifdef GGGGC_CONCURRENT_MARK
+    /* what it logged must still be marked */
+    ggggc_satbFlush(&ggggc_thread);
+#endif
+    for (ti = &ggggc_threads; *ti; ti = &(*ti)->next) {
+        if (*ti == &ggggc_thread) {
+            *ti = ggggc_thread.next;
+            break;
+        }
+    }
+    ggc_mutex_lock_raw(&ggggc_worldLock);
+    ggggc_runningThreads--;
+    ggggc_thread.registered = 0;
+    ggc_mutex_unlock(&ggggc_worldLock);
+    ggc_mutex_unlock(&ggggc_allocLock);
+}
+
+#if defined(GGGGC_THREADS_POSIX)
+struct ThreadArgs {
+    void *(*routine)(void *);
+    void *arg;
+};
+
+/* the real routine of threads made by ggc_thread_create */
+static void *threadWrapper(void *argsVp)
+{
+    struct ThreadArgs args = *(struct ThreadArgs *) argsVp;
+    void *ret;
+
+    free(argsVp);
+
+    ggggc_registerThread();
+    ret = args.routine(args.arg);
+    ggggc_unregisterThread();
+
+    return ret;
+}
+
+int ggc_thread_create(ggc_thread_t *thread, void *(*routine)(void *), void *arg)
+{
+    struct ThreadArgs *args;
+    int ret;
+
+    args = (struct ThreadArgs *) malloc(sizeof(struct ThreadArgs));
+    if (args == NULL) return ENOMEM;
+    args->routine = routine;
+    args->arg = arg;
+
+    ret = pthread_create(thread, NULL, threadWrapper, args);
+    if (ret != 0) free(args);
+    return ret;
+}
+
+int ggc_thread_join(ggc_thread_t thread)
+{
+    int ret;
+    ggc_pre_blocking();
+    ret = pthread_join(thread, NULL);
+    ggc_post_blocking();
+    return ret;
+}
+
+#else
+int ggc_thread_create(ggc_thread_t *thread, void *(*routine)(void *), void *arg)
+{
+    return ENOSYS;
+}
+
+int ggc_thread_join(ggc_thread_t thread)
+{
+    return ENOSYS;
+}
+
+#endif
+
+#ifdef __cplusplus
+}
+#endif